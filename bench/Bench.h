@@ -0,0 +1,105 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_BUFFER_BENCH_H
+#define TKS_BUFFER_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct BenchCase {
+    const char *name;
+
+    void (*run)();
+};
+
+std::vector<BenchCase> &bench_registry();
+
+struct BenchRegistrar {
+    BenchRegistrar(const char *name, void (*run)()) {
+        bench_registry().push_back({name, run});
+    }
+};
+
+/*
+ * Declares a benchmark group. `buffer_bench foo bar` only runs groups whose name contains
+ * one of the arguments.
+ */
+#define BENCH(group) \
+    static void bench_##group(); \
+    static BenchRegistrar bench_registrar_##group(#group, bench_##group); \
+    static void bench_##group()
+
+template<typename T>
+inline void do_not_optimize(T const &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+inline uint64_t bench_now_ns() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Runs op in batches sized to roughly 20us, after a warm-up, for about 200ms. Each batch
+ * yields one ns/op sample; the report gives throughput and the p50/p90/p99 of those samples.
+ * bytes_per_op is only used for the MB/s column and may be 0.
+ */
+template<typename F>
+void measure(const std::string &name, uint64_t bytes_per_op, F &&op) {
+    uint64_t batch = 1;
+    while (true) {
+        uint64_t start = bench_now_ns();
+        for (uint64_t a = 0; a < batch; a++) {
+            op();
+        }
+        if (bench_now_ns() - start >= 20000 || batch >= (1u << 24)) {
+            break;
+        }
+        batch *= 2;
+    }
+    for (int a = 0; a < 10; a++) {
+        for (uint64_t b = 0; b < batch; b++) {
+            op();
+        }
+    }
+
+    std::vector<double> samples;
+    samples.reserve(10000);
+    uint64_t total_ops = 0;
+    uint64_t began = bench_now_ns();
+    uint64_t elapsed = 0;
+    while (elapsed < 200000000ull && samples.size() < 10000) {
+        uint64_t start = bench_now_ns();
+        for (uint64_t a = 0; a < batch; a++) {
+            op();
+        }
+        uint64_t end = bench_now_ns();
+        samples.push_back((double) (end - start) / (double) batch);
+        total_ops += batch;
+        elapsed = end - began;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        return samples[std::min(samples.size() - 1, (size_t) (p * (double) samples.size()))];
+    };
+    double seconds = (double) elapsed / 1e9;
+    double ops = (double) total_ops / seconds;
+    printf("%-48s %14.0f ops/s", name.c_str(), ops);
+    if (bytes_per_op != 0) {
+        printf(" %10.1f MB/s", ops * (double) bytes_per_op / 1e6);
+    } else {
+        printf(" %15s", "");
+    }
+    printf("   p50 %9.1f  p90 %9.1f  p99 %9.1f ns/op\n", percentile(0.5), percentile(0.9),
+           percentile(0.99));
+}
+
+#endif //TKS_BUFFER_BENCH_H
@@ -0,0 +1,71 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "BuffersStorage.h"
+#include <atomic>
+#include <thread>
+
+static const uint32_t class_sizes[] = {8, 128, 1024, 4096, 16384, 40000, 160000};
+
+/*
+ * The measuring thread takes and returns a buffer while `contenders` other threads do the
+ * same on the shared pool, so the percentiles include lock waits.
+ */
+static void measure_get_reuse(uint32_t size, uint32_t contenders, const std::string &suffix = "") {
+    std::atomic<bool> running{true};
+    std::vector<std::thread> threads;
+    for (uint32_t a = 0; a < contenders; a++) {
+        threads.emplace_back([&running, size]() {
+            while (running.load(std::memory_order_relaxed)) {
+                BuffersStorage::get().get_free_buffer(size)->reuse();
+            }
+        });
+    }
+    std::string name = "get_free_buffer+reuse " + std::to_string(size) + " threads " +
+                       std::to_string(contenders + 1) + suffix;
+    measure(name, 0, [size]() {
+        ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size);
+        do_not_optimize(buffer);
+        buffer->reuse();
+    });
+    running = false;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+BENCH(buffers_storage) {
+    for (uint32_t size : class_sizes) {
+        measure_get_reuse(size, 0);
+    }
+    for (uint32_t contenders : {1u, 3u, 7u}) {
+        measure_get_reuse(128, contenders);
+        measure_get_reuse(16384, contenders);
+    }
+
+    // Lifetime tracing: every buffer recorded, and the production sampling rate.
+    for (uint32_t rate : {1u, 64u}) {
+        BuffersStorage::get().set_tracing(rate);
+        measure("get_free_buffer+reuse 1024 traced 1 in " + std::to_string(rate), 0, []() {
+            ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(1024, "bench");
+            do_not_optimize(buffer);
+            buffer->reuse();
+        });
+    }
+
+    // Sampling with one traced buffer held for the whole run, the leak this is meant to find:
+    // unsampled releases from every thread must not queue on the trace lock.
+    BuffersStorage::get().set_tracing(1);
+    ProtoBuffer *held = BuffersStorage::get().get_free_buffer(1024, "bench held");
+    BuffersStorage::get().set_tracing(64);
+    for (uint32_t contenders : {0u, 3u, 7u}) {
+        measure_get_reuse(1024, contenders, " traced 1 in 64, one held");
+    }
+    held->reuse();
+    BuffersStorage::get().set_tracing(0);
+    BuffersStorage::get().reset_tracing();
+}
@@ -0,0 +1,51 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "ByteStream.h"
+#include "BuffersStorage.h"
+
+static ProtoBuffer *filled_buffer(uint32_t size) {
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size);
+    while (buffer->has_remaining()) {
+        buffer->write_byte(0x42);
+    }
+    buffer->rewind();
+    return buffer;
+}
+
+/*
+ * Keeps `depth` segments queued and, per operation, appends one segment, copies one
+ * segment's worth out with get() and discards it: the steady state of a connection whose
+ * send queue never drains.
+ */
+static void measure_queue(uint32_t segment_size, uint32_t depth) {
+    ByteStream stream;
+    for (uint32_t a = 0; a < depth; a++) {
+        stream.append(filled_buffer(segment_size));
+    }
+    ProtoBuffer *dst = BuffersStorage::get().get_free_buffer(segment_size);
+    std::string name = "append+get+discard " + std::to_string(segment_size) + " depth " +
+                       std::to_string(depth);
+    measure(name, segment_size, [&]() {
+        stream.append(filled_buffer(segment_size));
+        dst->clear();
+        dst->limit(segment_size);
+        stream.get(dst);
+        stream.discard(segment_size);
+    });
+    name = "has_data " + std::to_string(segment_size) + " depth " + std::to_string(depth);
+    measure(name, 0, [&]() { do_not_optimize(stream.has_data()); });
+    dst->reuse();
+    stream.clean();
+}
+
+BENCH(byte_stream) {
+    for (uint32_t depth : {1u, 64u, 1024u}) {
+        measure_queue(128, depth);
+        measure_queue(4096, depth);
+    }
+}
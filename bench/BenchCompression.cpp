@@ -0,0 +1,68 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "BuffersStorage.h"
+#include "Compression.h"
+
+/*
+ * Something shaped like a sync response: constructor ids, small counters, random 64-bit ids
+ * and strings drawn from a small vocabulary, serialized with the TL writers.
+ */
+static ProtoBuffer *sync_like_payload(uint32_t size) {
+    static const char *words[] = {"en", "fr", "image/jpeg", "video/mp4", "Hello there", "steve",
+                                  "channel_update", "https://example.org/a/very/long/path", "ok"};
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size);
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    while (buffer->remaining() >= 64) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        buffer->write_int((uint32_t) 0x1cb5c415);
+        buffer->write_int((int32_t) (state >> 60));
+        buffer->write_long((int64_t) state);
+        buffer->write_string(words[(state >> 33) % (sizeof(words) / sizeof(words[0]))]);
+    }
+    while (buffer->has_remaining()) {
+        buffer->write_byte(0);
+    }
+    buffer->rewind();
+    return buffer;
+}
+
+static void measure_codec(const char *label, CompressionCodec codec, int32_t level, uint32_t size) {
+    if (!Compressor::available(codec)) {
+        printf("%s: codec not built in\n", label);
+        return;
+    }
+    Compressor compressor(codec, 0, level);
+    ProtoBuffer *payload = sync_like_payload(size);
+    ProtoBuffer *frame = compressor.compress(payload);
+    printf("%-10s %6u bytes -> %6u (ratio %.2f)\n", label, size, frame->limit() - Compressor::header_size,
+           (double) size / (double) (frame->limit() - Compressor::header_size));
+
+    std::string name = std::string("compress ") + label + " " + std::to_string(size);
+    measure(name, size, [&]() {
+        ProtoBuffer *out = compressor.compress(payload);
+        do_not_optimize(out);
+        out->reuse();
+    });
+    name = std::string("decompress ") + label + " " + std::to_string(size);
+    measure(name, size, [&]() {
+        frame->position(0);
+        ProtoBuffer *out = Compressor::decompress(frame);
+        do_not_optimize(out);
+        out->reuse();
+    });
+    frame->reuse();
+    payload->reuse();
+}
+
+BENCH(compression) {
+    for (uint32_t size : {128u, 1024u, 4096u, 16384u, 40000u, 160000u}) {
+        measure_codec("lz4", CompressionCodec::lz4, 1, size);
+        measure_codec("zlib-1", CompressionCodec::zlib, 1, size);
+        measure_codec("zlib-6", CompressionCodec::zlib, 6, size);
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "ConstructorRegistry.h"
+#include <unordered_map>
+
+static uint32_t decode_id(ProtoBuffer *buffer, uint32_t constructor, bool * /*error*/) {
+    return constructor + buffer->position();
+}
+
+/*
+ * Lookup of random registered ids among `count` types: the perfect hash against a sorted
+ * table searched with lower_bound and against std::unordered_map.
+ */
+static void measure_lookup(uint32_t count) {
+    typedef ConstructorRegistry<uint32_t>::Decoder Decoder;
+    ConstructorRegistry<uint32_t> registry;
+    std::vector<std::pair<uint32_t, Decoder>> sorted;
+    std::unordered_map<uint32_t, Decoder> map;
+    uint32_t state = 12345;
+    std::vector<uint32_t> ids;
+    for (uint32_t a = 0; a < count; a++) {
+        state = state * 1664525u + 1013904223u;
+        ids.push_back(state);
+        registry.add(state, decode_id);
+        sorted.emplace_back(state, decode_id);
+        map[state] = decode_id;
+    }
+    registry.build();
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<uint32_t> probes;
+    for (uint32_t a = 0; a < 4096; a++) {
+        state = state * 1664525u + 1013904223u;
+        probes.push_back(ids[state % count]);
+    }
+    ProtoBuffer buffer((uint32_t) 8);
+    uint32_t next = 0;
+
+    std::string suffix = " " + std::to_string(count) + " types";
+    measure("perfect hash" + suffix, 0, [&]() {
+        uint32_t id = probes[next++ & 4095];
+        do_not_optimize(registry.decode(&buffer, id));
+    });
+    measure("sorted table" + suffix, 0, [&]() {
+        uint32_t id = probes[next++ & 4095];
+        auto found = std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(id, (Decoder) nullptr));
+        do_not_optimize(found->second(&buffer, id, nullptr));
+    });
+    measure("unordered_map" + suffix, 0, [&]() {
+        uint32_t id = probes[next++ & 4095];
+        do_not_optimize(map.find(id)->second(&buffer, id, nullptr));
+    });
+}
+
+BENCH(constructor_registry) {
+    for (uint32_t count : {64u, 1024u, 8192u}) {
+        measure_lookup(count);
+    }
+}
@@ -0,0 +1,41 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "MemCopy.h"
+#include <memory>
+
+static const uint32_t copy_sizes[] = {4, 8, 12, 16, 128, 1024 + 200, 4096 + 200, 16384 + 200, 40000,
+                                      160000, 256 * 1024, 512 * 1024, 1024 * 1024};
+
+/*
+ * Destinations rotate over ~16MB so large copies land in cold memory, as they do when a
+ * pooled buffer is filled.
+ */
+BENCH(mem_copy) {
+    for (uint32_t size : copy_sizes) {
+        uint32_t count = std::max<uint32_t>(2, (16u * 1024 * 1024) / size);
+        count = std::min<uint32_t>(count, 4096);
+        std::unique_ptr<uint8_t[]> src(new uint8_t[size]);
+        std::unique_ptr<uint8_t[]> dst(new uint8_t[(size_t) size * count]);
+        memset(src.get(), 0x5a, size);
+        memset(dst.get(), 0, (size_t) size * count);
+        uint32_t index = 0;
+        measure("memcpy " + std::to_string(size), size, [&]() {
+            uint8_t *target = dst.get() + (size_t) size * index;
+            memcpy(target, src.get(), size);
+            do_not_optimize(target);
+            index = index + 1 == count ? 0 : index + 1;
+        });
+        index = 0;
+        measure("buffer_copy " + std::to_string(size), size, [&]() {
+            uint8_t *target = dst.get() + (size_t) size * index;
+            buffer_copy(target, src.get(), size);
+            do_not_optimize(target);
+            index = index + 1 == count ? 0 : index + 1;
+        });
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "BuffersStorage.h"
+#include "MessageIndex.h"
+
+/*
+ * A container of `count` messages, each an int32 constructor, an int64 id and a string.
+ */
+static ProtoBuffer *container(uint32_t count) {
+    ProtoBuffer *message = BuffersStorage::get().get_free_buffer(128);
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(8 + count * 64);
+    buffer->write_int((uint32_t) MessageIndex::vector_constructor);
+    buffer->write_int(count);
+    for (uint32_t a = 0; a < count; a++) {
+        message->clear();
+        message->write_int((uint32_t) (0x10000000 + a % 16));
+        message->write_long((int64_t) a);
+        message->write_string("message body with some text");
+        message->flip();
+        buffer->write_byte_array(message);
+    }
+    buffer->flip();
+    message->reuse();
+    return buffer;
+}
+
+BENCH(message_index) {
+    for (uint32_t count : {16u, 256u, 2048u}) {
+        ProtoBuffer *buffer = container(count);
+        MessageIndex index;
+        std::string name = "scan " + std::to_string(count) + " messages";
+        measure(name, buffer->limit(), [&]() {
+            index.scan(buffer);
+            do_not_optimize(index.size());
+        });
+        name = "decode last of " + std::to_string(count) + " (sequential)";
+        measure(name, 0, [&]() {
+            buffer->position(8);
+            ProtoBuffer *last = nullptr;
+            for (uint32_t a = 0; a < count; a++) {
+                delete last;
+                last = buffer->read_proto_buff(false);
+            }
+            do_not_optimize(last->read_int());
+            delete last;
+            buffer->position(0);
+        });
+        name = "decode last of " + std::to_string(count) + " (index)";
+        measure(name, 0, [&]() {
+            index.scan(buffer);
+            ProtoBuffer last(index.bytes(index.size() - 1), index.entry(index.size() - 1).length);
+            do_not_optimize(last.read_int());
+        });
+        for (uint32_t threads : {1u, 0u}) {
+            ThreadPool pool(threads);
+            std::vector<int64_t> ids;
+            name = "decode all " + std::to_string(count) + " on " + std::to_string(pool.size()) + " threads";
+            measure(name, buffer->limit(), [&]() {
+                index.scan(buffer);
+                index.decode(pool, &ids, [](ProtoBuffer *message, bool *error) {
+                    message->read_int(error);
+                    int64_t id = message->read_long(error);
+                    std::string_view text = message->read_string_view(error);
+                    return id + (int64_t) text.size();
+                });
+                do_not_optimize(ids.back());
+            });
+        }
+        buffer->reuse();
+    }
+}
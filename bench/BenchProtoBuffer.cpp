@@ -0,0 +1,166 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "ProtoBuffer.h"
+#include "BuffersStorage.h"
+#include "Bytes.h"
+
+static const uint32_t scratch_size = 64 * 1024;
+
+/*
+ * Byte array payload lengths: empty, short (1-byte header), the largest short one, the
+ * smallest long one (4-byte header) and a few larger payloads.
+ */
+static const uint32_t array_lengths[] = {0, 7, 32, 253, 254, 1024, 16384};
+
+template<typename F>
+static void measure_write(const char *name, uint32_t size, F &&write) {
+    ProtoBuffer buffer(scratch_size);
+    measure(name, size, [&]() {
+        if (buffer.remaining() < size) {
+            buffer.rewind();
+        }
+        write(buffer);
+    });
+}
+
+template<typename F>
+static void measure_read(const char *name, uint32_t size, ProtoBuffer &buffer, F &&read) {
+    buffer.rewind();
+    measure(name, size, [&]() {
+        if (buffer.remaining() < size) {
+            buffer.rewind();
+        }
+        read(buffer);
+    });
+}
+
+BENCH(proto_buffer_write) {
+    int32_t i = 0x12345678;
+    int64_t l = 0x1234567890abcdefLL;
+    double d = 3.14159;
+    uint8_t bytes[16] = {};
+    measure_write("write_int", 4, [&](ProtoBuffer &b) { b.write_int(i); });
+    measure_write("write_int_BE", 4, [&](ProtoBuffer &b) { b.write_int_BE(i); });
+    measure_write("write_long", 8, [&](ProtoBuffer &b) { b.write_long(l); });
+    measure_write("write_double", 8, [&](ProtoBuffer &b) { b.write_double(d); });
+    measure_write("write_byte", 1, [&](ProtoBuffer &b) { b.write_byte(7); });
+    measure_write("write_bytes 16", 16, [&](ProtoBuffer &b) { b.write_bytes(bytes, 16); });
+
+    int32_t ints[256];
+    int64_t longs[256];
+    for (int a = 0; a < 256; a++) {
+        ints[a] = a * 977;
+        longs[a] = (int64_t) a * 1000003;
+    }
+    measure_write("write_int x256 (loop)", 1024, [&](ProtoBuffer &b) {
+        for (int32_t v : ints) {
+            b.write_int(v);
+        }
+    });
+    measure_write("write_int_array 256", 1024, [&](ProtoBuffer &b) { b.write_int_array(ints, 256); });
+    measure_write("write_int_array_BE 256", 1024, [&](ProtoBuffer &b) { b.write_int_array_BE(ints, 256); });
+    measure_write("write_long x256 (loop)", 2048, [&](ProtoBuffer &b) {
+        for (int64_t v : longs) {
+            b.write_long(v);
+        }
+    });
+    measure_write("write_long_array 256", 2048, [&](ProtoBuffer &b) { b.write_long_array(longs, 256); });
+
+    std::vector<uint8_t> payload(16384, 'x');
+    for (uint32_t length : array_lengths) {
+        uint32_t size = length + 8;
+        measure_write(("write_byte_array " + std::to_string(length)).c_str(), size, [&](ProtoBuffer &b) {
+            b.write_byte_array(payload.data(), length);
+        });
+    }
+}
+
+BENCH(proto_buffer_read) {
+    ProtoBuffer buffer(scratch_size);
+    while (buffer.remaining() >= 8) {
+        buffer.write_long(0x1234567890abcdefLL);
+    }
+    buffer.flip();
+
+    measure_read("read_int", 4, buffer, [](ProtoBuffer &b) { do_not_optimize(b.read_int()); });
+    measure_read("read_int_BE", 4, buffer, [](ProtoBuffer &b) { do_not_optimize(b.read_int_BE()); });
+    measure_read("read_long", 8, buffer, [](ProtoBuffer &b) { do_not_optimize(b.read_long()); });
+    measure_read("read_double", 8, buffer, [](ProtoBuffer &b) { do_not_optimize(b.read_double()); });
+    measure_read("read_byte", 1, buffer, [](ProtoBuffer &b) { do_not_optimize(b.read_byte()); });
+    uint8_t bytes[16];
+    measure_read("read_bytes 16", 16, buffer, [&](ProtoBuffer &b) {
+        b.read_bytes(bytes, 16);
+        do_not_optimize(bytes);
+    });
+
+    int32_t ints[256];
+    int64_t longs[256];
+    measure_read("read_int x256 (loop)", 1024, buffer, [&](ProtoBuffer &b) {
+        for (int32_t &v : ints) {
+            v = b.read_int();
+        }
+        do_not_optimize(ints);
+    });
+    measure_read("read_int_array 256", 1024, buffer, [&](ProtoBuffer &b) {
+        b.read_int_array(ints, 256);
+        do_not_optimize(ints);
+    });
+    measure_read("read_int_array_BE 256", 1024, buffer, [&](ProtoBuffer &b) {
+        b.read_int_array_BE(ints, 256);
+        do_not_optimize(ints);
+    });
+    measure_read("read_long x256 (loop)", 2048, buffer, [&](ProtoBuffer &b) {
+        for (int64_t &v : longs) {
+            v = b.read_long();
+        }
+        do_not_optimize(longs);
+    });
+    measure_read("read_long_array 256", 2048, buffer, [&](ProtoBuffer &b) {
+        b.read_long_array(longs, 256);
+        do_not_optimize(longs);
+    });
+}
+
+BENCH(proto_buffer_strings) {
+    std::string payload(16384, 'y');
+    for (uint32_t length : array_lengths) {
+        ProtoBuffer buffer(scratch_size);
+        uint32_t count = 0;
+        while (buffer.remaining() >= length + 8) {
+            buffer.write_byte_array((uint8_t *) payload.data(), length);
+            count++;
+        }
+        buffer.flip();
+        uint32_t used = buffer.limit();
+        uint32_t size = used / count;
+        std::string suffix = " " + std::to_string(length);
+
+        auto read_all = [&](const char *name, auto &&read) {
+            buffer.rewind();
+            measure(name + suffix, size, [&]() {
+                if (buffer.position() + size > used) {
+                    buffer.rewind();
+                }
+                read(buffer);
+            });
+        };
+        read_all("read_string", [](ProtoBuffer &b) { do_not_optimize(b.read_string()); });
+        read_all("read_string_view", [](ProtoBuffer &b) { do_not_optimize(b.read_string_view()); });
+        buffer.validate_utf8(true);
+        read_all("read_string_view utf8", [](ProtoBuffer &b) { do_not_optimize(b.read_string_view()); });
+        buffer.validate_utf8(false);
+        read_all("read_byte_array", [](ProtoBuffer &b) { delete b.read_byte_array(); });
+        read_all("read_proto_buff copy", [](ProtoBuffer &b) {
+            ProtoBuffer *result = b.read_proto_buff(true);
+            if (result != nullptr) {
+                result->reuse();
+            }
+        });
+        read_all("read_proto_buff slice", [](ProtoBuffer &b) { delete b.read_proto_buff(false); });
+    }
+}
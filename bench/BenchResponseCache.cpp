@@ -0,0 +1,53 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "ProtoBuffer.h"
+#include "ResponseCache.h"
+
+/*
+ * A config-like response: a vector of 64 (id, name, flags) entries, about 2KB encoded.
+ */
+static void encode_config(ProtoBuffer *buffer) {
+    buffer->write_int((uint32_t) 0x1cb5c415);
+    buffer->write_int(64);
+    for (int32_t a = 0; a < 64; a++) {
+        buffer->write_long(1000 + a);
+        buffer->write_string("config.option.name." + std::to_string(a));
+        buffer->write_int(a & 7);
+    }
+}
+
+/*
+ * Serving the same response per request: encoding it into a fresh pooled buffer against
+ * appending the cached buffer to the stream.
+ */
+BENCH(response_cache) {
+    ProtoBuffer sizer(true);
+    encode_config(&sizer);
+    const uint32_t size = sizer.capacity();
+    ByteStream stream;
+
+    measure("encode per request", size, [&]() {
+        ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size);
+        encode_config(buffer);
+        buffer->flip();
+        stream.append(buffer);
+        stream.clean();
+    });
+
+    ResponseCache cache;
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size);
+    encode_config(buffer);
+    buffer->flip();
+    cache.put(1, buffer);
+    measure("cached append_to", size, [&]() {
+        cache.append_to(1, &stream);
+        stream.clean();
+    });
+}
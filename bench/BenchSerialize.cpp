@@ -0,0 +1,61 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "Serialize.h"
+
+struct BenchPosition {
+    int64_t id;
+    int32_t x;
+    int32_t y;
+    double speed;
+    int64_t time;
+    bool moving;
+    BUFFER_FIELDS(id, x, y, speed, time, moving)
+};
+
+/*
+ * A struct of fixed fields written and read field by field with write_* / read_* against the
+ * single run copy BUFFER_FIELDS lowers it to.
+ */
+BENCH(serialize) {
+    BenchPosition position{42, 7, -3, 1.5, 1665000000, true};
+    const uint32_t size = serialized_fixed_size<BenchPosition>();
+    ProtoBuffer buffer(size);
+
+    measure("write_* per field", size, [&]() {
+        buffer.rewind();
+        buffer.write_long(position.id);
+        buffer.write_int(position.x);
+        buffer.write_int(position.y);
+        buffer.write_double(position.speed);
+        buffer.write_long(position.time);
+        buffer.write_int(position.moving ? (uint32_t) 0x997275b5 : (uint32_t) 0xbc799737);
+        do_not_optimize(buffer);
+    });
+    measure("BUFFER_FIELDS serialize", size, [&]() {
+        buffer.rewind();
+        position.serialize(&buffer);
+        do_not_optimize(buffer);
+    });
+
+    BenchPosition decoded{};
+    measure("read_* per field", size, [&]() {
+        buffer.rewind();
+        decoded.id = buffer.read_long();
+        decoded.x = buffer.read_int();
+        decoded.y = buffer.read_int();
+        decoded.speed = buffer.read_double();
+        decoded.time = buffer.read_long();
+        decoded.moving = buffer.read_u_int() == 0x997275b5;
+        do_not_optimize(decoded);
+    });
+    measure("BUFFER_FIELDS deserialize", size, [&]() {
+        buffer.rewind();
+        decoded.deserialize(&buffer);
+        do_not_optimize(decoded);
+    });
+}
@@ -0,0 +1,152 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "ProtoBuffer.h"
+#include "Varint.h"
+
+/*
+ * A record shaped like our messages: a 64-bit id, a date, two small counters and a signed
+ * delta. Ids and counters are mostly small, which is what the varint mode is for.
+ */
+struct BenchRecord {
+    int64_t id;
+    int32_t date;
+    int32_t views;
+    int32_t replies;
+    int32_t delta;
+};
+
+static const uint32_t record_count = 4096;
+
+static std::vector<BenchRecord> make_records() {
+    std::vector<BenchRecord> records;
+    uint32_t state = 7;
+    for (uint32_t a = 0; a < record_count; a++) {
+        state = state * 1664525u + 1013904223u;
+        records.push_back({(int64_t) (100000 + a * 3), (int32_t) (1665000000 + a), (int32_t) (state >> 20),
+                           (int32_t) (state >> 28), (int32_t) (state >> 24) - 128});
+    }
+    return records;
+}
+
+static void write_tl(ProtoBuffer &buffer, const std::vector<BenchRecord> &records) {
+    for (const BenchRecord &record : records) {
+        buffer.write_long(record.id);
+        buffer.write_int(record.date);
+        buffer.write_int(record.views);
+        buffer.write_int(record.replies);
+        buffer.write_int(record.delta);
+    }
+}
+
+static void write_compact(ProtoBuffer &buffer, const std::vector<BenchRecord> &records) {
+    for (const BenchRecord &record : records) {
+        buffer.write_varint((uint64_t) record.id);
+        buffer.write_varint((uint32_t) record.date);
+        buffer.write_varint((uint32_t) record.views);
+        buffer.write_varint((uint32_t) record.replies);
+        buffer.write_zigzag(record.delta);
+    }
+}
+
+/*
+ * The same records in TL mode (fixed 4/8-byte integers) and compact mode (varints and zigzag):
+ * encoded size, then encode and decode speed per record.
+ */
+BENCH(varint) {
+    std::vector<BenchRecord> records = make_records();
+    ProtoBuffer tl_size(true);
+    write_tl(tl_size, records);
+    ProtoBuffer compact_size(true);
+    write_compact(compact_size, records);
+    printf("%u records: tl %u bytes, compact %u bytes (%.1f%%)\n", record_count, tl_size.capacity(),
+           compact_size.capacity(), 100.0 * compact_size.capacity() / tl_size.capacity());
+
+    ProtoBuffer tl(tl_size.capacity());
+    ProtoBuffer compact(compact_size.capacity());
+    uint32_t next = 0;
+
+    measure("tl write record", 24, [&]() {
+        const BenchRecord &record = records[next++ & (record_count - 1)];
+        if (tl.remaining() < 24) {
+            tl.rewind();
+        }
+        tl.write_long(record.id);
+        tl.write_int(record.date);
+        tl.write_int(record.views);
+        tl.write_int(record.replies);
+        tl.write_int(record.delta);
+    });
+    measure("compact write record", 0, [&]() {
+        const BenchRecord &record = records[next++ & (record_count - 1)];
+        if (compact.remaining() < 40) {
+            compact.rewind();
+        }
+        compact.write_varint((uint64_t) record.id);
+        compact.write_varint((uint32_t) record.date);
+        compact.write_varint((uint32_t) record.views);
+        compact.write_varint((uint32_t) record.replies);
+        compact.write_zigzag(record.delta);
+    });
+
+    tl.clear();
+    write_tl(tl, records);
+    tl.flip();
+    compact.clear();
+    write_compact(compact, records);
+    compact.flip();
+    BenchRecord decoded{};
+    measure("tl read record", 24, [&]() {
+        if (!tl.has_remaining()) {
+            tl.rewind();
+        }
+        decoded.id = tl.read_long();
+        decoded.date = tl.read_int();
+        decoded.views = tl.read_int();
+        decoded.replies = tl.read_int();
+        decoded.delta = tl.read_int();
+        do_not_optimize(decoded);
+    });
+    measure("compact read record", 0, [&]() {
+        if (!compact.has_remaining()) {
+            compact.rewind();
+        }
+        decoded.id = (int64_t) compact.read_varint();
+        decoded.date = (int32_t) compact.read_varint();
+        decoded.views = (int32_t) compact.read_varint();
+        decoded.replies = (int32_t) compact.read_varint();
+        decoded.delta = (int32_t) compact.read_zigzag();
+        do_not_optimize(decoded);
+    });
+
+    // The decoders alone over varints of random length (1 to 8 bytes): the per-byte loop
+    // against the branch-reduced path read_varint uses when 8 bytes are available.
+    std::vector<uint8_t> stream(64 * 1024 + 16);
+    uint32_t end = 0;
+    uint32_t state = 11;
+    while (end + varint_max_size <= 64 * 1024) {
+        state = state * 1664525u + 1013904223u;
+        uint64_t value = ((uint64_t) state << 24 | state) >> (state % 56);
+        end += varint_encode(stream.data() + end, value);
+    }
+    uint32_t position = 0;
+    uint64_t value = 0;
+    measure("varint decode byte loop", 0, [&]() {
+        if (position >= end) {
+            position = 0;
+        }
+        position += varint_decode_slow(stream.data() + position, end - position, &value);
+        do_not_optimize(value);
+    });
+    measure("varint decode branch-reduced", 0, [&]() {
+        if (position >= end) {
+            position = 0;
+        }
+        position += varint_decode_fast(stream.data() + position, end + 16 - position, &value);
+        do_not_optimize(value);
+    });
+}
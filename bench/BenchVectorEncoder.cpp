@@ -0,0 +1,64 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include "VectorEncoder.h"
+
+struct ExportItem {
+    int64_t id;
+    int32_t date;
+    std::string text;
+};
+
+static void encode_item(const ExportItem &item, ProtoBuffer *buffer, bool *error) {
+    buffer->write_int((uint32_t) 0x2a9b0b3c, error);
+    buffer->write_long(item.id, error);
+    buffer->write_int(item.date, error);
+    buffer->write_string(item.text, error);
+}
+
+/*
+ * One calculate-size pass and one oversized buffer on the calling thread, against
+ * encode_vector on a single-thread pool and on a pool sized to the machine.
+ */
+BENCH(vector_encode) {
+    std::vector<ExportItem> items(100000);
+    for (uint32_t a = 0; a < items.size(); a++) {
+        items[a].id = (int64_t) a * 7919;
+        items[a].date = (int32_t) a;
+        items[a].text.assign(16 + a % 48, (char) ('a' + a % 26));
+    }
+    auto count = (uint32_t) items.size();
+    ProtoBuffer sizer(true);
+    for (const ExportItem &item : items) {
+        encode_item(item, &sizer, nullptr);
+    }
+    uint32_t bytes = sizer.capacity() + 8;
+
+    measure("serial, one buffer", bytes, [&]() {
+        ProtoBuffer size(true);
+        for (const ExportItem &item : items) {
+            encode_item(item, &size, nullptr);
+        }
+        ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size.capacity() + 8);
+        buffer->write_int((uint32_t) 0x1cb5c415);
+        buffer->write_int(count);
+        for (const ExportItem &item : items) {
+            encode_item(item, buffer, nullptr);
+        }
+        do_not_optimize(buffer->position());
+        buffer->reuse();
+    });
+    for (uint32_t threads : {1u, 0u}) {
+        ThreadPool pool(threads);
+        ByteStream stream;
+        std::string name = "encode_vector on " + std::to_string(pool.size()) + " threads";
+        measure(name, bytes, [&]() {
+            encode_vector(pool, items.data(), count, encode_item, &stream);
+            stream.clean();
+        });
+    }
+}
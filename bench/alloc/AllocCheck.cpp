@@ -0,0 +1,225 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+/*
+ * buffer_alloc_check: replaces the global operator new/delete with counting versions and
+ * runs the steady-state encode/decode loops after a warm-up. Exits non-zero if any of the
+ * zero-allocation paths allocates, and reports allocations per operation for the paths
+ * that are expected to allocate.
+ */
+
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "Bytes.h"
+#include "Checksum.h"
+#include "ProtoBuffer.h"
+#include "ResponseCache.h"
+#include "StringInterner.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> allocation_count{0};
+
+void *operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *result = malloc(size == 0 ? 1 : size);
+    if (result == nullptr) {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+static const uint32_t warm_up_iterations = 1000;
+static const uint32_t measured_iterations = 10000;
+static int failures = 0;
+
+/*
+ * Runs op for the warm-up, then returns the number of allocations per measured iteration.
+ */
+template<typename F>
+static double allocations_per_op(F &&op) {
+    for (uint32_t a = 0; a < warm_up_iterations; a++) {
+        op();
+    }
+    uint64_t before = allocation_count.load();
+    for (uint32_t a = 0; a < measured_iterations; a++) {
+        op();
+    }
+    return (double) (allocation_count.load() - before) / measured_iterations;
+}
+
+template<typename F>
+static void expect_no_allocations(const char *name, F &&op) {
+    double count = allocations_per_op(op);
+    printf("%-52s %8.3f allocs/op  %s\n", name, count, count == 0 ? "ok" : "FAIL");
+    if (count != 0) {
+        failures++;
+    }
+}
+
+template<typename F>
+static void report_allocations(const char *name, F &&op) {
+    printf("%-52s %8.3f allocs/op\n", name, allocations_per_op(op));
+}
+
+static void serialize(ProtoBuffer *buffer) {
+    static const int64_t ids[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+    static const std::string text = "steady state string that is longer than the SSO buffer";
+    buffer->write_int(0x1cb5c415);
+    buffer->write_long(0x1234567890LL);
+    buffer->write_double(2.5);
+    buffer->write_string(text);
+    buffer->write_long_array(ids, 16);
+}
+
+int main() {
+    BuffersStorage &storage = BuffersStorage::get();
+
+    for (uint32_t size : {8u, 128u, 1024u, 4096u, 16384u, 40000u, 160000u}) {
+        std::string name = "get_free_buffer+reuse " + std::to_string(size);
+        expect_no_allocations(name.c_str(), [&storage, size]() {
+            storage.get_free_buffer(size)->reuse();
+        });
+    }
+
+    expect_no_allocations("serialize+deserialize pooled buffer", [&storage]() {
+        ProtoBuffer *buffer = storage.get_free_buffer(512);
+        serialize(buffer);
+        buffer->flip();
+        int64_t ids[16];
+        buffer->read_int();
+        buffer->read_long();
+        buffer->read_double();
+        buffer->read_string_view();
+        buffer->read_long_array(ids, 16);
+        buffer->reuse();
+    });
+
+    expect_no_allocations("serialize with crc32c tracking", [&storage]() {
+        ProtoBuffer *buffer = storage.get_free_buffer(512);
+        Crc32c crc;
+        crc.track(buffer);
+        serialize(buffer);
+        crc.update_written();
+        buffer->reuse();
+    });
+
+    ByteStream stream;
+    ProtoBuffer *dst = storage.get_free_buffer(4096);
+    expect_no_allocations("ByteStream append+get+discard", [&]() {
+        for (int a = 0; a < 4; a++) {
+            ProtoBuffer *buffer = storage.get_free_buffer(1024);
+            serialize(buffer);
+            buffer->flip();
+            stream.append(buffer);
+        }
+        dst->clear();
+        stream.get(dst);
+        stream.discard(dst->position());
+        stream.has_data();
+    });
+    stream.clean();
+
+    ResponseCache cache;
+    ProtoBuffer *response = storage.get_free_buffer(2048);
+    serialize(response);
+    response->flip();
+    cache.put(1, response);
+    expect_no_allocations("ResponseCache append_to+get+discard", [&]() {
+        cache.append_to(1, &stream);
+        cache.append_to(1, &stream);
+        dst->clear();
+        stream.get(dst);
+        stream.discard(dst->position());
+    });
+    stream.clean();
+    dst->reuse();
+
+    ProtoBuffer *source = storage.get_free_buffer(1024);
+    source->write_string("short");
+    source->write_string(std::string(300, 'x'));
+    source->write_byte_array((uint8_t *) "payload", 7);
+    source->flip();
+    report_allocations("read_string (short, SSO)", [source]() {
+        source->rewind();
+        source->read_string();
+    });
+    report_allocations("read_string (300 bytes)", [source]() {
+        source->position(8);
+        source->read_string();
+    });
+    report_allocations("read_byte_array", [source]() {
+        source->position(8 + 304);
+        delete source->read_byte_array();
+    });
+    report_allocations("read_proto_buff (copy)", [source]() {
+        source->position(8 + 304);
+        source->read_proto_buff(true)->reuse();
+    });
+    report_allocations("read_proto_buff (slice)", [source]() {
+        source->position(8 + 304);
+        delete source->read_proto_buff(false);
+    });
+    source->reuse();
+
+    ProtoBuffer *repeated = storage.get_free_buffer(1024);
+    for (int a = 0; a < 8; a++) {
+        repeated->write_string("application/vnd.telegram.sticker+tgs");
+        repeated->write_string("en");
+    }
+    repeated->flip();
+    StringInterner interner;
+    report_allocations("read_string x16 (repeated 36-byte MIME type)", [repeated]() {
+        repeated->rewind();
+        while (repeated->has_remaining()) {
+            repeated->read_string();
+        }
+    });
+    expect_no_allocations("read_interned_string x16 (repeated values)", [repeated, &interner]() {
+        repeated->rewind();
+        while (repeated->has_remaining()) {
+            repeated->read_interned_string(&interner);
+        }
+    });
+    repeated->reuse();
+
+    if (failures != 0) {
+        printf("%d steady-state path(s) allocated\n", failures);
+        return 1;
+    }
+    return 0;
+}
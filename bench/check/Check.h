@@ -0,0 +1,46 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_BUFFER_CHECK_H
+#define TKS_BUFFER_CHECK_H
+
+#include <cstdio>
+#include <vector>
+
+struct CheckCase {
+    const char *name;
+
+    void (*run)();
+};
+
+std::vector<CheckCase> &check_registry();
+
+int &check_failures();
+
+struct CheckRegistrar {
+    CheckRegistrar(const char *name, void (*run)()) {
+        check_registry().push_back({name, run});
+    }
+};
+
+/*
+ * Declares a group of behaviour checks. `buffer_check foo bar` only runs groups whose name
+ * contains one of the arguments; the tool exits non-zero if any EXPECT failed.
+ */
+#define CHECK(group) \
+    static void check_##group(); \
+    static CheckRegistrar check_registrar_##group(#group, check_##group); \
+    static void check_##group()
+
+#define EXPECT(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+            check_failures()++; \
+        } \
+    } while (0)
+
+#endif //TKS_BUFFER_CHECK_H
@@ -0,0 +1,119 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "ByteSwap.h"
+#include "ProtoBuffer.h"
+#include <cstring>
+#include <vector>
+
+// Counts below, at and just past every vector width the kernels use.
+static const uint32_t array_counts[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 33, 100};
+
+static uint64_t pattern(uint32_t a) {
+    return 0x0102030405060708ull * (a + 1) ^ 0xf0e1d2c3b4a59687ull;
+}
+
+CHECK(arrays_swap_kernels) {
+    for (uint32_t count : array_counts) {
+        // Odd offsets, so neither pointer is aligned.
+        std::vector<uint8_t> src(count * 8 + 3);
+        std::vector<uint8_t> dst(count * 8 + 3, 0xee);
+        for (uint32_t a = 0; a < src.size(); a++) {
+            src[a] = (uint8_t) (a * 31 + 7);
+        }
+        swap_copy32(dst.data() + 1, src.data() + 3, count);
+        bool same = dst[0] == 0xee;
+        for (uint32_t a = 0; a < count; a++) {
+            uint32_t v;
+            uint32_t w;
+            memcpy(&v, src.data() + 3 + a * 4, 4);
+            memcpy(&w, dst.data() + 1 + a * 4, 4);
+            same = same && w == __builtin_bswap32(v);
+        }
+        same = same && dst[1 + count * 4] == 0xee;
+        EXPECT(same);
+
+        std::fill(dst.begin(), dst.end(), 0xee);
+        swap_copy64(dst.data() + 1, src.data() + 3, count);
+        same = dst[0] == 0xee;
+        for (uint32_t a = 0; a < count; a++) {
+            uint64_t v;
+            uint64_t w;
+            memcpy(&v, src.data() + 3 + a * 8, 8);
+            memcpy(&w, dst.data() + 1 + a * 8, 8);
+            same = same && w == __builtin_bswap64(v);
+        }
+        same = same && (count * 8 + 1 >= dst.size() || dst[1 + count * 8] == 0xee);
+        EXPECT(same);
+    }
+}
+
+CHECK(arrays_round_trip) {
+    for (uint32_t count : array_counts) {
+        std::vector<int32_t> ints(count);
+        std::vector<int64_t> longs(count);
+        std::vector<double> doubles(count);
+        for (uint32_t a = 0; a < count; a++) {
+            ints[a] = (int32_t) pattern(a);
+            longs[a] = (int64_t) pattern(a);
+            doubles[a] = (double) (int64_t) pattern(a) / 3.0;
+        }
+        uint32_t size = 1 + count * (4 + 4 + 8 + 8);
+        std::vector<uint8_t> bulk(size);
+        std::vector<uint8_t> single(size);
+
+        // The bulk writers produce the same bytes as the per-value writers, from an odd offset.
+        ProtoBuffer bulk_buffer(bulk.data(), size);
+        ProtoBuffer single_buffer(single.data(), size);
+        bool error = false;
+        bulk_buffer.write_byte(0x55, &error);
+        single_buffer.write_byte(0x55, &error);
+        bulk_buffer.write_int_array(ints.data(), count, &error);
+        bulk_buffer.write_int_array_BE(ints.data(), count, &error);
+        bulk_buffer.write_long_array(longs.data(), count, &error);
+        bulk_buffer.write_double_array(doubles.data(), count, &error);
+        for (int32_t x : ints) {
+            single_buffer.write_int(x, &error);
+        }
+        for (int32_t x : ints) {
+            single_buffer.write_int_BE(x, &error);
+        }
+        for (int64_t x : longs) {
+            single_buffer.write_long(x, &error);
+        }
+        for (double x : doubles) {
+            single_buffer.write_double(x, &error);
+        }
+        EXPECT(!error);
+        EXPECT(bulk_buffer.position() == size && bulk == single);
+
+        bulk_buffer.flip();
+        bulk_buffer.position(1);
+        std::vector<int32_t> read_ints(count + 1, 0);
+        std::vector<int32_t> read_ints_be(count + 1, 0);
+        std::vector<int64_t> read_longs(count + 1, 0);
+        std::vector<double> read_doubles(count + 1, 0);
+        bulk_buffer.read_int_array(read_ints.data(), count, &error);
+        bulk_buffer.read_int_array_BE(read_ints_be.data(), count, &error);
+        bulk_buffer.read_long_array(read_longs.data(), count, &error);
+        bulk_buffer.read_double_array(read_doubles.data(), count, &error);
+        EXPECT(!error && !bulk_buffer.has_remaining());
+        read_ints.pop_back();
+        read_ints_be.pop_back();
+        read_longs.pop_back();
+        read_doubles.pop_back();
+        EXPECT(read_ints == ints && read_ints_be == ints && read_longs == longs);
+        EXPECT(count == 0 || memcmp(read_doubles.data(), doubles.data(), count * sizeof(double)) == 0);
+
+        // One element short is refused and leaves the position alone.
+        if (count != 0) {
+            bulk_buffer.position(size - count * 4);
+            bulk_buffer.read_int_array_BE(read_ints_be.data(), count + 1, &error);
+            EXPECT(error && bulk_buffer.position() == size - count * 4);
+        }
+    }
+}
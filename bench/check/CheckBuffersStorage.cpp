@@ -0,0 +1,88 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "BuffersStorage.h"
+#include <string>
+#include <vector>
+
+static const BuffersStorage::LiveBuffer *find_live(const std::vector<BuffersStorage::LiveBuffer> &live,
+                                                   const std::string &tag) {
+    for (const BuffersStorage::LiveBuffer &buffer : live) {
+        if (buffer.tag == tag) {
+            return &buffer;
+        }
+    }
+    return nullptr;
+}
+
+static const BuffersStorage::HoldHistogram *find_histogram(
+        const std::vector<std::pair<std::string, BuffersStorage::HoldHistogram>> &histograms, const std::string &tag) {
+    for (const auto &item : histograms) {
+        if (item.first == tag) {
+            return &item.second;
+        }
+    }
+    return nullptr;
+}
+
+CHECK(buffers_storage_tracing) {
+    BuffersStorage &storage = BuffersStorage::get();
+    storage.reset_tracing();
+    storage.set_tracing(1);
+    EXPECT(storage.tracing() == 1);
+
+    ProtoBuffer *buffer = storage.get_free_buffer(700, "check tracing");
+    ProtoBuffer *untagged = storage.get_free_buffer(100);
+    std::vector<BuffersStorage::LiveBuffer> live = storage.live_buffers();
+    EXPECT(live.size() == 2);
+    const BuffersStorage::LiveBuffer *record = find_live(live, "check tracing");
+    EXPECT(record != nullptr && record->size == 700 && record->capacity == buffer->capacity());
+    // Untagged buffers are named after the call site.
+    EXPECT(live.size() == 2 && !(record == &live[0] ? live[1] : live[0]).tag.empty());
+    EXPECT(storage.tracing_report().find("check tracing") != std::string::npos);
+
+    buffer->reuse();
+    untagged->reuse();
+    EXPECT(storage.live_buffers().empty());
+    std::vector<std::pair<std::string, BuffersStorage::HoldHistogram>> histograms = storage.hold_histograms();
+    const BuffersStorage::HoldHistogram *histogram = find_histogram(histograms, "check tracing");
+    EXPECT(histogram != nullptr && histogram->count == 1);
+    uint64_t bucketed = 0;
+    for (uint32_t a = 0; histogram != nullptr && a < BuffersStorage::HoldHistogram::bucket_count; a++) {
+        bucketed += histogram->buckets[a];
+    }
+    EXPECT(bucketed == 1);
+
+    // Sampling records every Nth buffer a thread takes.
+    storage.reset_tracing();
+    storage.set_tracing(4);
+    std::vector<ProtoBuffer *> taken;
+    for (uint32_t a = 0; a < 16; a++) {
+        taken.push_back(storage.get_free_buffer(64, "check sampled"));
+    }
+    EXPECT(storage.live_buffers().size() == 4);
+    for (ProtoBuffer *item : taken) {
+        item->reuse();
+    }
+    histograms = storage.hold_histograms();
+    histogram = find_histogram(histograms, "check sampled");
+    EXPECT(storage.live_buffers().empty() && histogram != nullptr && histogram->count == 4);
+
+    // Forgetting the records while a traced buffer is out: its release finds nothing to
+    // account for and the buffer goes back to the pool as usual.
+    storage.set_tracing(1);
+    ProtoBuffer *held = storage.get_free_buffer(64, "check reset");
+    storage.set_tracing(0);
+    storage.reset_tracing();
+    EXPECT(storage.live_buffers().empty() && storage.hold_histograms().empty());
+    held->reuse();
+    EXPECT(storage.live_buffers().empty() && storage.hold_histograms().empty());
+    ProtoBuffer *again = storage.get_free_buffer(64, "check reset");
+    EXPECT(again != nullptr && again->limit() == 64);
+    again->reuse();
+    EXPECT(storage.live_buffers().empty() && storage.hold_histograms().empty());
+}
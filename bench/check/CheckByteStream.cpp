@@ -0,0 +1,113 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "ProtoBuffer.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+static int temp_file(const char *content) {
+    char path[] = "/tmp/buffer_check_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (write(fd, content, strlen(content)) != (ssize_t) strlen(content)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static ProtoBuffer *filled(const char *content) {
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer((uint32_t) strlen(content));
+    buffer->write_bytes((uint8_t *) content, (uint32_t) strlen(content));
+    buffer->flip();
+    return buffer;
+}
+
+CHECK(byte_stream_empty_file_segment) {
+    int fd = temp_file("unused");
+    EXPECT(fd >= 0);
+    ByteStream stream;
+    stream.append_file(fd, 0, 0);
+    stream.append(filled("after"));
+    ProtoBuffer *dst = BuffersStorage::get().get_free_buffer(64);
+    dst->clear();
+    stream.get(dst);
+    EXPECT(dst->position() == 5);
+    EXPECT(memcmp(dst->bytes(), "after", 5) == 0);
+    stream.discard(dst->position());
+    EXPECT(!stream.has_data());
+    stream.clean();
+    dst->reuse();
+    close(fd);
+}
+
+CHECK(byte_stream_file_segment_into_full_dst) {
+    int fd = temp_file("0123456789");
+    EXPECT(fd >= 0);
+    ByteStream stream;
+    stream.append(filled("abcd"));
+    stream.append_file(fd, 2, 6, true);
+    stream.append(filled("xyz"));
+
+    uint8_t bytes[4];
+    ProtoBuffer dst(bytes, sizeof(bytes));
+    stream.get(&dst);
+    EXPECT(dst.position() == 4);
+    stream.discard(4);
+
+    std::string received;
+    for (int a = 0; a < 8 && stream.has_data(); a++) {
+        dst.clear();
+        stream.get(&dst);
+        EXPECT(dst.position() != 0);
+        received.append((const char *) bytes, dst.position());
+        stream.discard(dst.position());
+    }
+    EXPECT(received == "234567xyz");
+    stream.clean();
+}
+
+CHECK(byte_stream_discard_zero) {
+    ByteStream stream;
+    stream.append(filled("abc"));
+    stream.append(filled("defg"));
+    stream.discard(0);
+    ProtoBuffer *dst = BuffersStorage::get().get_free_buffer(64);
+    dst->clear();
+    stream.get(dst);
+    EXPECT(dst->position() == 7 && memcmp(dst->bytes(), "abcdefg", 7) == 0);
+
+    // Consuming the head exactly stops there; the next segment is untouched.
+    stream.discard(3);
+    stream.discard(0);
+    dst->clear();
+    stream.get(dst);
+    EXPECT(dst->position() == 4 && memcmp(dst->bytes(), "defg", 4) == 0);
+
+    // An exhausted segment left at the head is skipped by readers and dropped by the next
+    // non-empty discard.
+    stream.discard(4);
+    stream.append(filled(""));
+    stream.append(filled("xy"));
+    stream.discard(0);
+    EXPECT(stream.has_data() && stream.has_data(2) && !stream.has_data(3));
+    dst->clear();
+    stream.get(dst);
+    EXPECT(dst->position() == 2 && memcmp(dst->bytes(), "xy", 2) == 0);
+    stream.discard(2);
+    EXPECT(!stream.has_data());
+    stream.clean();
+    dst->reuse();
+}
@@ -0,0 +1,44 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "Checksum.h"
+#include "ProtoBuffer.h"
+#include <cstring>
+
+CHECK(checksum_buffer_range) {
+    uint8_t bytes[64];
+    for (uint32_t a = 0; a < sizeof(bytes); a++) {
+        bytes[a] = (uint8_t) (a * 7);
+    }
+    ProtoBuffer buffer(bytes, sizeof(bytes));
+
+    Crc32c crc;
+    bool error = false;
+    crc.update(&buffer, 8, 40, &error);
+    EXPECT(!error);
+    EXPECT(crc.value() == Crc32c::compute(bytes + 8, 40));
+
+    XxHash64 hash;
+    hash.update(&buffer, 8, 40, &error);
+    EXPECT(!error);
+    EXPECT(hash.value() == XxHash64::compute(bytes + 8, 40));
+
+    // offset + len wraps to 0x10 in 32 bits; that must not pass for in range.
+    for (uint32_t offset : {0xfffffff0u, 60u}) {
+        Crc32c wrapped;
+        error = false;
+        wrapped.update(&buffer, offset, 0x20, &error);
+        EXPECT(error);
+        EXPECT(wrapped.value() == 0);
+
+        XxHash64 wrapped_hash;
+        error = false;
+        wrapped_hash.update(&buffer, offset, 0x20, &error);
+        EXPECT(error);
+        EXPECT(wrapped_hash.value() == XxHash64::compute(nullptr, 0));
+    }
+}
@@ -0,0 +1,126 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "Compression.h"
+#include "ProtoBuffer.h"
+#include <cstring>
+#include <string>
+
+static std::string payload(uint32_t length) {
+    std::string result;
+    while (result.size() < length) {
+        result += "compressible payload " + std::to_string(result.size() % 97) + "; ";
+    }
+    result.resize(length);
+    return result;
+}
+
+static std::string drain(ByteStream *stream) {
+    std::string result;
+    uint8_t bytes[4096];
+    ProtoBuffer dst(bytes, sizeof(bytes));
+    while (stream->has_data()) {
+        dst.clear();
+        stream->get(&dst);
+        result.append((const char *) bytes, dst.position());
+        stream->discard(dst.position());
+    }
+    return result;
+}
+
+static ProtoBuffer *slice(ProtoBuffer *frame, uint32_t offset, uint32_t length) {
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(length);
+    buffer->write_bytes(frame->bytes(), offset, length);
+    buffer->flip();
+    return buffer;
+}
+
+CHECK(compression_stream_partial_frame) {
+    Compressor compressor;
+    std::string input = payload(20000);
+    ProtoBuffer *frame = compressor.compress((const uint8_t *) input.data(), (uint32_t) input.size());
+    EXPECT(frame != nullptr);
+    uint32_t frame_size = frame->limit();
+
+    ByteStream src;
+    ByteStream dst;
+    bool error = false;
+    uint32_t fed = 0;
+    uint32_t produced = 0;
+    // A few bytes at a time, header split too: nothing comes out until the last piece.
+    for (uint32_t step : {5u, 9u, frame_size / 3, frame_size / 3}) {
+        src.append(slice(frame, fed, step));
+        fed += step;
+        produced += Compressor::decompress(&src, &dst, &error);
+        EXPECT(produced == 0);
+        EXPECT(src.has_data(fed));
+        EXPECT(!src.has_data(fed + 1));
+    }
+    src.append(slice(frame, fed, frame_size - fed));
+    produced += Compressor::decompress(&src, &dst, &error);
+    EXPECT(!error);
+    EXPECT(produced == input.size());
+    EXPECT(!src.has_data());
+    EXPECT(drain(&dst) == input);
+    frame->reuse();
+}
+
+CHECK(compression_stream_oversized_header) {
+    // A well-formed header announcing a 256MB stored frame, with nothing behind it.
+    uint8_t bytes[Compressor::header_size];
+    ProtoBuffer header(bytes, sizeof(bytes));
+    header.write_int((uint32_t) CompressionCodec::stored);
+    header.write_int((uint32_t) (256 * 1024 * 1024));
+    header.write_int((uint32_t) (256 * 1024 * 1024));
+    ByteStream src;
+    ByteStream dst;
+    src.append(slice(&header, 0, sizeof(bytes)));
+    bool error = false;
+    for (int a = 0; a < 3; a++) {
+        EXPECT(Compressor::decompress(&src, &dst, &error) == 0);
+    }
+    EXPECT(!error);
+    EXPECT(src.has_data(Compressor::header_size));
+    EXPECT(!dst.has_data());
+    src.clean();
+}
+
+CHECK(compression_payload_limit) {
+    Compressor compressor;
+    uint8_t byte = 0;
+    bool error = false;
+    // The length is rejected before any byte is read.
+    EXPECT(compressor.compress(&byte, 256 * 1024 * 1024 + 1, &error) == nullptr);
+    EXPECT(error);
+}
+
+CHECK(compression_zlib_level_clamped) {
+    if (!Compressor::available(CompressionCodec::zlib)) {
+        return;
+    }
+    std::string input = payload(8192);
+    for (int32_t level : {-5, 42}) {
+        Compressor compressor(CompressionCodec::zlib, 512, level);
+        bool error = false;
+        ProtoBuffer *frame = compressor.compress((const uint8_t *) input.data(), (uint32_t) input.size(), &error);
+        EXPECT(!error);
+        // Level 0 stores, which never shrinks, so only the top level must come out deflated.
+        if (level > 9) {
+            EXPECT(frame->read_int() == (int32_t) CompressionCodec::zlib);
+            frame->position(0);
+        }
+        ProtoBuffer *output = Compressor::decompress(frame, &error);
+        EXPECT(!error);
+        EXPECT(output != nullptr && std::string((const char *) output->bytes(), output->limit()) == input);
+        if (output != nullptr) {
+            output->reuse();
+        }
+        frame->reuse();
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "ConstructorRegistry.h"
+#include <unordered_set>
+#include <vector>
+
+static uint32_t decode_first(ProtoBuffer * /*buffer*/, uint32_t constructor, bool * /*error*/) {
+    return constructor ^ 0x1u;
+}
+
+static uint32_t decode_second(ProtoBuffer * /*buffer*/, uint32_t constructor, bool * /*error*/) {
+    return constructor ^ 0x2u;
+}
+
+static uint32_t next_id(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state;
+}
+
+CHECK(constructor_registry_lookup) {
+    typedef ConstructorRegistry<uint32_t> Registry;
+    for (uint32_t count : {1u, 2u, 64u, 1000u, 8192u}) {
+        Registry registry;
+        uint32_t state = count;
+        std::vector<uint32_t> ids;
+        std::unordered_set<uint32_t> registered;
+        while (ids.size() < count) {
+            uint32_t id = next_id(&state);
+            if (registered.insert(id).second) {
+                ids.push_back(id);
+                registry.add(id, ids.size() % 2 == 0 ? decode_first : decode_second);
+            }
+        }
+        bool error = false;
+        EXPECT(registry.build(&error));
+        EXPECT(!error && registry.size() == count);
+
+        bool resolved = true;
+        for (uint32_t a = 0; a < count; a++) {
+            Registry::Decoder expected = (a + 1) % 2 == 0 ? decode_first : decode_second;
+            resolved = resolved && registry.find(ids[a]) == expected;
+        }
+        EXPECT(resolved);
+
+        // Unknown ids, including 0, which free slots are initialised with.
+        bool unknown = registry.find(0) == nullptr || registered.count(0) != 0;
+        for (uint32_t a = 0; a < 100000; a++) {
+            uint32_t id = next_id(&state) ^ 0x5bd1e995u;
+            if (registered.count(id) == 0) {
+                unknown = unknown && registry.find(id) == nullptr;
+            }
+        }
+        EXPECT(unknown);
+    }
+}
+
+CHECK(constructor_registry_decode) {
+    ConstructorRegistry<uint32_t> registry;
+    EXPECT(registry.find(0x12345678) == nullptr);
+    registry.add(0x12345678, decode_first);
+    registry.add(0x0badf00d, decode_second);
+    EXPECT(registry.build());
+
+    uint8_t bytes[8];
+    ProtoBuffer buffer(bytes, sizeof(bytes));
+    buffer.write_int((uint32_t) 0x0badf00d);
+    buffer.write_int((uint32_t) 0x7fffffff);
+    buffer.flip();
+    bool error = false;
+    EXPECT(registry.decode(&buffer, &error) == (0x0badf00du ^ 0x2u));
+    EXPECT(!error);
+    EXPECT(registry.decode(&buffer, &error) == 0);
+    EXPECT(error);
+    error = false;
+    EXPECT(registry.decode(&buffer, &error) == 0);
+    EXPECT(error);
+    error = false;
+    EXPECT(registry.decode(&buffer, 0x12345678, &error) == (0x12345678u ^ 0x1u));
+    EXPECT(!error);
+
+    // A duplicate id fails the build and keeps the previous table.
+    registry.add(0x12345678, decode_second);
+    error = false;
+    EXPECT(!registry.build(&error));
+    EXPECT(error);
+    EXPECT(registry.size() == 2 && registry.find(0x12345678) == decode_first);
+}
@@ -0,0 +1,215 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "IoDriver.h"
+#include "ProtoBuffer.h"
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/*
+ * Runs the driver over a connected pair of non-blocking sockets, one end added to the driver
+ * and the other driven directly: receive, a send larger than the socket buffer, an idle
+ * period that must not produce completions, and an orderly close by the peer.
+ */
+class Recorder : public IoDriver::Delegate {
+public:
+    std::string received;
+    uint64_t sent{0};
+    int closed_fd{-1};
+    int closed_error{-1};
+
+    void on_data_received(int /*fd*/, ByteStream *input, uint32_t count) override {
+        uint8_t bytes[65536];
+        ProtoBuffer dst(bytes, sizeof(bytes));
+        while (input->has_data()) {
+            dst.clear();
+            input->get(&dst);
+            received.append((const char *) bytes, dst.position());
+            input->discard(dst.position());
+        }
+        received_calls += count != 0;
+    }
+
+    void on_data_sent(int /*fd*/, uint32_t count) override {
+        sent += count;
+    }
+
+    void on_connection_closed(int fd, int error) override {
+        closed_fd = fd;
+        closed_error = error;
+    }
+
+    uint32_t received_calls{0};
+};
+
+static bool set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static bool socket_pair(int fds[2]) {
+    return socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) == 0;
+}
+
+static bool loopback_pair(int fds[2]) {
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    bool ok = listener >= 0 && bind(listener, (struct sockaddr *) &address, sizeof(address)) == 0 &&
+              listen(listener, 1) == 0 && getsockname(listener, (struct sockaddr *) &address, &length) == 0;
+    fds[0] = fds[1] = -1;
+    if (ok) {
+        fds[1] = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ok = fds[1] >= 0 && connect(fds[1], (struct sockaddr *) &address, sizeof(address)) == 0;
+    }
+    if (ok) {
+        fds[0] = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        ok = fds[0] >= 0 && set_non_blocking(fds[0]) && set_non_blocking(fds[1]);
+    }
+    if (listener >= 0) {
+        close(listener);
+    }
+    return ok;
+}
+
+static void drain_peer(int fd, std::string *out) {
+    char bytes[65536];
+    ssize_t result;
+    while ((result = read(fd, bytes, sizeof(bytes))) > 0) {
+        out->append(bytes, (size_t) result);
+    }
+}
+
+static void exercise(bool use_io_uring, bool (*make_pair)(int[2]), const char *transport) {
+    Recorder recorder;
+    IoDriver *driver = IoDriver::create(&recorder, 4096, 8, use_io_uring);
+    EXPECT(driver != nullptr);
+    if (driver == nullptr) {
+        return;
+    }
+    if (use_io_uring && !driver->uses_io_uring()) {
+        printf("  io_uring unavailable, %s check ran on epoll\n", transport);
+    }
+    int fds[2];
+    EXPECT(make_pair(fds));
+    ByteStream input;
+    ByteStream output;
+    EXPECT(driver->add(fds[0], &input));
+
+    // Receive: more than one receive buffer's worth, so several completions are needed.
+    std::string message(10000, 'r');
+    for (size_t a = 0; a < message.size(); a++) {
+        message[a] = (char) ('a' + a % 26);
+    }
+    EXPECT(write(fds[1], message.data(), message.size()) == (ssize_t) message.size());
+    for (int a = 0; a < 100 && recorder.received.size() < message.size(); a++) {
+        driver->poll(10);
+    }
+    EXPECT(recorder.received == message);
+
+    // Idle: with nothing to read, the pending receive must not complete over and over. A
+    // kernel that honours O_NONBLOCK reports one -EAGAIN before the driver waits on readability.
+    int32_t idle_events = 0;
+    for (int a = 0; a < 5; a++) {
+        idle_events += driver->poll(10);
+    }
+    EXPECT(idle_events <= 1);
+
+    // Send: 1MB, well past the socket buffer, so the driver has to wait for writability.
+    const uint32_t chunk = 16384;
+    const uint32_t total = 64 * chunk;
+    for (uint32_t a = 0; a < total / chunk; a++) {
+        ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(chunk);
+        for (uint32_t b = 0; b < chunk; b++) {
+            buffer->write_byte((uint8_t) ((a * chunk + b) % 251));
+        }
+        buffer->flip();
+        output.append(buffer);
+    }
+    EXPECT(driver->send(fds[0], &output));
+    std::string peer_received;
+    for (int a = 0; a < 2000 && (peer_received.size() < total || recorder.sent < total); a++) {
+        driver->poll(1);
+        drain_peer(fds[1], &peer_received);
+    }
+    EXPECT(peer_received.size() == total);
+    EXPECT(recorder.sent == total);
+    bool intact = peer_received.size() == total;
+    for (uint32_t a = 0; a < total && intact; a++) {
+        intact = (uint8_t) peer_received[a] == (uint8_t) (a % 251);
+    }
+    EXPECT(intact);
+    EXPECT(!output.has_data());
+
+    // Orderly close by the peer.
+    close(fds[1]);
+    for (int a = 0; a < 100 && recorder.closed_fd < 0; a++) {
+        driver->poll(10);
+    }
+    EXPECT(recorder.closed_fd == fds[0]);
+    EXPECT(recorder.closed_error == 0);
+
+    delete driver;
+    close(fds[0]);
+    input.clean();
+    output.clean();
+}
+
+CHECK(io_driver_io_uring_socketpair) {
+    exercise(true, socket_pair, "socketpair");
+}
+
+CHECK(io_driver_io_uring_loopback) {
+    exercise(true, loopback_pair, "loopback");
+}
+
+CHECK(io_driver_epoll_socketpair) {
+    exercise(false, socket_pair, "socketpair");
+}
+
+CHECK(io_driver_epoll_loopback) {
+    exercise(false, loopback_pair, "loopback");
+}
+
+CHECK(io_driver_delete_with_pending_receive) {
+    for (bool use_io_uring : {true, false}) {
+        Recorder recorder;
+        IoDriver *driver = IoDriver::create(&recorder, 4096, 8, use_io_uring);
+        EXPECT(driver != nullptr);
+        if (driver == nullptr) {
+            continue;
+        }
+        int fds[2];
+        EXPECT(socket_pair(fds));
+        ByteStream input;
+        EXPECT(driver->add(fds[0], &input));
+        driver->poll(0);
+        // The receive is still in flight; the driver must cancel it before its buffers go back
+        // to the pool, so the write below can't land in a reused buffer.
+        delete driver;
+        EXPECT(write(fds[1], "late", 4) == 4);
+        EXPECT(recorder.closed_fd < 0);
+        close(fds[0]);
+        close(fds[1]);
+        input.clean();
+    }
+}
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "Journal.h"
+#include "ProtoBuffer.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+static std::string temp_directory() {
+    char path[] = "/tmp/buffer_check_journal_XXXXXX";
+    return mkdtemp(path) != nullptr ? path : "";
+}
+
+static void remove_directory(const std::string &directory) {
+    for (const std::string &segment : Journal::segments(directory)) {
+        unlink(segment.c_str());
+    }
+    rmdir(directory.c_str());
+}
+
+static std::string frame_payload(uint32_t index) {
+    // Lengths cycle through every padding case.
+    return "frame " + std::to_string(index) + std::string(index % 37, (char) ('a' + index % 26));
+}
+
+static uint64_t append_payload(Journal *journal, const std::string &payload, bool *error) {
+    ProtoBuffer buffer((uint8_t *) payload.data(), (uint32_t) payload.size());
+    return journal->append(&buffer, error);
+}
+
+static std::vector<std::string> replay(const std::string &directory, bool *error) {
+    std::vector<std::string> frames;
+    JournalReader reader(directory);
+    ProtoBuffer *frame;
+    while ((frame = reader.next(error)) != nullptr) {
+        frames.emplace_back((const char *) frame->bytes() + frame->position(), frame->remaining());
+    }
+    return frames;
+}
+
+CHECK(journal_append_group_commit) {
+    std::string directory = temp_directory();
+    EXPECT(!directory.empty());
+    bool error = false;
+    Journal *journal = Journal::open(directory, 1024 * 1024, &error);
+    EXPECT(journal != nullptr && !error);
+
+    uint64_t first = append_payload(journal, frame_payload(0), &error);
+    EXPECT(first == 1);
+    journal->commit(first, &error);
+    EXPECT(!error);
+    // Already durable: returns without another sync, and with nothing pending either.
+    journal->commit(first, &error);
+    journal->commit(UINT64_MAX, &error);
+    EXPECT(!error);
+
+    // Threads append and commit their own frames; commits share fdatasyncs.
+    const uint32_t threads = 4;
+    const uint32_t per_thread = 200;
+    std::vector<std::thread> workers;
+    std::vector<bool> failed(threads, false);
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back([journal, t, &failed]() {
+            for (uint32_t a = 0; a < per_thread; a++) {
+                bool thread_error = false;
+                uint64_t sequence = append_payload(journal, "thread " + std::to_string(t) + " frame " +
+                                                            std::to_string(a), &thread_error);
+                if (a % 10 == 9) {
+                    journal->commit(sequence, &thread_error);
+                }
+                if (sequence == 0 || thread_error) {
+                    failed[t] = true;
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    for (uint32_t t = 0; t < threads; t++) {
+        EXPECT(!failed[t]);
+    }
+    journal->commit(UINT64_MAX, &error);
+    EXPECT(!error);
+
+    // Committed frames are on disk, in each thread's order, before the journal is closed.
+    std::vector<std::string> frames = replay(directory, &error);
+    EXPECT(!error);
+    EXPECT(frames.size() == 1 + threads * per_thread);
+    std::vector<uint32_t> next(threads, 0);
+    for (size_t a = 1; a < frames.size(); a++) {
+        uint32_t t = (uint32_t) (frames[a][7] - '0');
+        EXPECT(t < threads && frames[a] == "thread " + std::to_string(t) + " frame " + std::to_string(next[t]));
+        if (t < threads) {
+            next[t]++;
+        }
+    }
+    delete journal;
+    remove_directory(directory);
+}
+
+CHECK(journal_rollover_and_replay) {
+    std::string directory = temp_directory();
+    bool error = false;
+    Journal *journal = Journal::open(directory, 4096, &error);
+    EXPECT(journal != nullptr);
+    const uint32_t count = 400;
+    for (uint32_t a = 0; a < count; a++) {
+        EXPECT(append_payload(journal, frame_payload(a), &error) == a + 1);
+    }
+    // A frame larger than a segment is refused without breaking the journal.
+    std::string oversized(4096, 'x');
+    bool oversized_error = false;
+    EXPECT(append_payload(journal, oversized, &oversized_error) == 0);
+    EXPECT(oversized_error);
+    delete journal;
+    EXPECT(!error);
+
+    EXPECT(Journal::segments(directory).size() > 3);
+    std::vector<std::string> frames = replay(directory, &error);
+    EXPECT(!error);
+    EXPECT(frames.size() == count);
+    for (uint32_t a = 0; a < count && a < frames.size(); a++) {
+        EXPECT(frames[a] == frame_payload(a));
+    }
+    remove_directory(directory);
+}
+
+CHECK(journal_corrupt_frame_ends_segment) {
+    std::string directory = temp_directory();
+    Journal *journal = Journal::open(directory, 4096);
+    EXPECT(journal != nullptr);
+    const uint32_t count = 400;
+    for (uint32_t a = 0; a < count; a++) {
+        append_payload(journal, frame_payload(a), nullptr);
+    }
+    delete journal;
+    std::vector<std::string> segments = Journal::segments(directory);
+    EXPECT(segments.size() >= 3);
+
+    // Flip a payload byte of the third frame in the first segment.
+    uint32_t offset = 0;
+    for (uint32_t a = 0; a < 2; a++) {
+        uint32_t len = (uint32_t) frame_payload(a).size();
+        offset += 8 + len + ((4 - (len & 3)) & 3);
+    }
+    int fd = open(segments[0].c_str(), O_RDWR);
+    EXPECT(fd >= 0);
+    uint8_t byte = 0;
+    EXPECT(pread(fd, &byte, 1, offset + 8) == 1);
+    byte ^= 0xff;
+    EXPECT(pwrite(fd, &byte, 1, offset + 8) == 1);
+    close(fd);
+
+    bool error = false;
+    std::vector<std::string> frames = replay(directory, &error);
+    EXPECT(error);
+    // Frames before the bad one survive; the rest of its segment is skipped and replay goes
+    // on with the next segment.
+    EXPECT(frames.size() > 2 && frames[0] == frame_payload(0) && frames[1] == frame_payload(1));
+    EXPECT(frames.size() < count);
+    uint32_t resumed = count - (uint32_t) (frames.size() - 2);
+    for (size_t a = 2; a < frames.size(); a++) {
+        EXPECT(frames[a] == frame_payload(resumed + (uint32_t) a - 2));
+    }
+
+    // A torn header, length far past the segment, is treated the same way.
+    fd = open(segments[1].c_str(), O_RDWR);
+    uint32_t torn = 0x7fffffff;
+    EXPECT(pwrite(fd, &torn, 4, 0) == 4);
+    close(fd);
+    error = false;
+    std::vector<std::string> after_torn = replay(directory, &error);
+    EXPECT(error);
+    EXPECT(after_torn.size() < frames.size());
+    remove_directory(directory);
+}
+
+CHECK(journal_reopen_continues) {
+    std::string directory = temp_directory();
+    Journal *journal = Journal::open(directory, 4096);
+    EXPECT(journal != nullptr);
+    for (uint32_t a = 0; a < 3; a++) {
+        append_payload(journal, frame_payload(a), nullptr);
+    }
+    delete journal;
+    std::vector<std::string> before = Journal::segments(directory);
+    EXPECT(before.size() == 1);
+
+    journal = Journal::open(directory, 4096);
+    EXPECT(journal != nullptr);
+    for (uint32_t a = 3; a < 5; a++) {
+        append_payload(journal, frame_payload(a), nullptr);
+    }
+    delete journal;
+    std::vector<std::string> after = Journal::segments(directory);
+    EXPECT(after.size() == 2);
+    EXPECT(after.size() == 2 && after[0] == before[0]);
+    EXPECT(after.size() == 2 && after[1] == directory + "/0000000000000002.journal");
+
+    bool error = false;
+    std::vector<std::string> frames = replay(directory, &error);
+    EXPECT(!error);
+    EXPECT(frames.size() == 5);
+    for (uint32_t a = 0; a < 5 && a < frames.size(); a++) {
+        EXPECT(frames[a] == frame_payload(a));
+    }
+    remove_directory(directory);
+}
@@ -0,0 +1,128 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "ProtoBuffer.h"
+#include <csignal>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static std::string temp_directory() {
+    char path[] = "/tmp/buffer_check_map_XXXXXX";
+    return mkdtemp(path) != nullptr ? path : "";
+}
+
+static bool file_exists(const std::string &path, off_t *size = nullptr) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    if (size != nullptr) {
+        *size = st.st_size;
+    }
+    return true;
+}
+
+CHECK(map_file_round_trip) {
+    std::string directory = temp_directory();
+    EXPECT(!directory.empty());
+    std::string path = directory + "/data";
+
+    bool error = false;
+    ProtoBuffer *writable = ProtoBuffer::map_file(path.c_str(), true, 4096, &error);
+    EXPECT(!error && writable != nullptr && writable->mapped() && writable->capacity() == 4096);
+    if (writable == nullptr) {
+        return;
+    }
+    writable->advise(ProtoBuffer::MapAdvice::sequential);
+    writable->write_int((int32_t) 0x12345678, &error);
+    writable->write_long((int64_t) -42, &error);
+    writable->write_string("mapped", &error);
+    writable->sync(&error);
+    EXPECT(!error);
+    // reuse() leaves a mapped buffer alone; deleting it unmaps.
+    writable->reuse();
+    EXPECT(writable->mapped());
+    delete writable;
+    off_t size = 0;
+    EXPECT(file_exists(path, &size) && size == 4096);
+
+    ProtoBuffer *readable = ProtoBuffer::map_file(path.c_str(), false, 0, &error);
+    EXPECT(!error && readable != nullptr && readable->mapped() && readable->capacity() == 4096);
+    if (readable != nullptr) {
+        readable->advise(ProtoBuffer::MapAdvice::random);
+        EXPECT(readable->read_int(&error) == 0x12345678);
+        EXPECT(readable->read_long(&error) == -42);
+        EXPECT(readable->read_string(&error) == "mapped");
+        EXPECT(!error);
+        // Nothing to flush on a private read-only map.
+        readable->sync(&error);
+        EXPECT(!error);
+        delete readable;
+    }
+
+    // A sized writable map of an existing file resizes it and keeps its leading bytes.
+    writable = ProtoBuffer::map_file(path.c_str(), true, 8192, &error);
+    EXPECT(!error && writable != nullptr && writable->capacity() == 8192);
+    if (writable != nullptr) {
+        EXPECT(writable->read_int(&error) == 0x12345678 && !error);
+        delete writable;
+    }
+
+    unlink(path.c_str());
+    rmdir(directory.c_str());
+}
+
+CHECK(map_file_errors) {
+    std::string directory = temp_directory();
+    EXPECT(!directory.empty());
+    std::string path = directory + "/data";
+
+    // A size on a read-only map is refused before anything is opened.
+    bool error = false;
+    EXPECT(ProtoBuffer::map_file(path.c_str(), false, 4096, &error) == nullptr && error);
+    EXPECT(!file_exists(path));
+
+    // Without a size the file has to exist and be non-empty.
+    error = false;
+    EXPECT(ProtoBuffer::map_file(path.c_str(), true, 0, &error) == nullptr && error);
+    EXPECT(!file_exists(path));
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    EXPECT(fd >= 0);
+    close(fd);
+    error = false;
+    EXPECT(ProtoBuffer::map_file(path.c_str(), false, 0, &error) == nullptr && error);
+    EXPECT(file_exists(path));
+
+    // Make the resize fail: a file the call created is removed again, one that was already
+    // there is left in place.
+    struct rlimit saved{};
+    getrlimit(RLIMIT_FSIZE, &saved);
+    struct rlimit lowered = saved;
+    lowered.rlim_cur = 4096;
+    void (*previous)(int) = signal(SIGXFSZ, SIG_IGN);
+    EXPECT(setrlimit(RLIMIT_FSIZE, &lowered) == 0);
+
+    error = false;
+    EXPECT(ProtoBuffer::map_file(path.c_str(), true, 1 << 20, &error) == nullptr && error);
+    off_t size = -1;
+    EXPECT(file_exists(path, &size) && size == 0);
+
+    std::string created = directory + "/created";
+    error = false;
+    EXPECT(ProtoBuffer::map_file(created.c_str(), true, 1 << 20, &error) == nullptr && error);
+    EXPECT(!file_exists(created));
+
+    setrlimit(RLIMIT_FSIZE, &saved);
+    signal(SIGXFSZ, previous);
+
+    unlink(path.c_str());
+    rmdir(directory.c_str());
+}
@@ -0,0 +1,184 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "BuffersStorage.h"
+#include "MessageIndex.h"
+#include <string>
+#include <vector>
+
+/*
+ * Message a: int32 constructor, int64 id, a string whose length crosses the 254-byte long
+ * header form; every 7th message is shorter than a constructor.
+ */
+static std::string message_bytes(uint32_t a) {
+    if (a % 7 == 3) {
+        return std::string(a % 4, (char) a);
+    }
+    ProtoBuffer message((uint32_t) 1024);
+    message.write_int((uint32_t) (0x10000000 + a % 5));
+    message.write_long((int64_t) a * 1000003);
+    message.write_string(std::string(a * 37 % 600, (char) ('a' + a % 26)));
+    return std::string((const char *) message.bytes(), message.position());
+}
+
+static ProtoBuffer *container(uint32_t count, bool with_constructor) {
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(16 + count * 1024);
+    if (with_constructor) {
+        buffer->write_int((uint32_t) MessageIndex::vector_constructor);
+    }
+    buffer->write_int(count);
+    for (uint32_t a = 0; a < count; a++) {
+        std::string bytes = message_bytes(a);
+        buffer->write_byte_array((uint8_t *) bytes.data(), (uint32_t) bytes.size());
+    }
+    buffer->flip();
+    return buffer;
+}
+
+CHECK(message_index_scan) {
+    for (bool with_constructor : {true, false}) {
+        const uint32_t count = 300;
+        ProtoBuffer *buffer = container(count, with_constructor);
+        MessageIndex index;
+        bool error = false;
+        EXPECT(index.scan(buffer, &error));
+        EXPECT(!error);
+        EXPECT(buffer->position() == 0);
+        EXPECT(index.size() == count);
+        EXPECT(index.end() == buffer->limit());
+
+        // The sequential read_proto_buff walk sees the same messages.
+        buffer->position(with_constructor ? 8 : 4);
+        for (uint32_t a = 0; a < count && a < index.size(); a++) {
+            std::string expected = message_bytes(a);
+            ProtoBuffer *sequential = buffer->read_proto_buff(false);
+            EXPECT(sequential != nullptr && sequential->bytes() == index.bytes(a));
+            EXPECT(index.entry(a).length == expected.size());
+            EXPECT(std::string((const char *) index.bytes(a), index.entry(a).length) == expected);
+            uint32_t constructor = expected.size() >= 4 ? 0x10000000 + a % 5 : 0;
+            EXPECT(index.entry(a).constructor == constructor);
+            ProtoBuffer *slice = index.slice(a);
+            EXPECT(slice->limit() == expected.size() && slice->bytes() == index.bytes(a));
+            delete slice;
+            delete sequential;
+        }
+        EXPECT(index.slice(count) == nullptr);
+
+        EXPECT(index.find(0x10000002) == 2);
+        EXPECT(index.find(0x10000002, 3) == 7);
+        EXPECT(index.find(0x10000004, count) == -1);
+        EXPECT(index.find(0x20000000) == -1);
+        buffer->reuse();
+    }
+}
+
+CHECK(message_index_malformed) {
+    ProtoBuffer *buffer = container(20, true);
+    MessageIndex index;
+    EXPECT(index.scan(buffer));
+
+    // Cut in the middle of the last message: refused, and the index is emptied.
+    buffer->limit(buffer->limit() - 2);
+    bool error = false;
+    EXPECT(!index.scan(buffer, &error));
+    EXPECT(error && index.size() == 0 && index.end() == 0);
+
+    // A count that can't fit in the bytes left.
+    buffer->limit(buffer->capacity());
+    buffer->position(4);
+    buffer->write_int((uint32_t) 0x40000000);
+    buffer->position(0);
+    buffer->limit(64);
+    error = false;
+    EXPECT(!index.scan(buffer, &error));
+    EXPECT(error && index.size() == 0);
+
+    // Truncated headers.
+    for (uint32_t limit : {0u, 3u, 6u}) {
+        buffer->limit(limit);
+        error = false;
+        EXPECT(!index.scan(buffer, &error));
+        EXPECT(error);
+    }
+    error = false;
+    EXPECT(!index.scan(nullptr, &error));
+    EXPECT(error);
+    buffer->reuse();
+}
+
+struct DecodedMessage {
+    uint32_t constructor;
+    int64_t id;
+    std::string text;
+};
+
+static DecodedMessage decode_message(ProtoBuffer *message, bool *error) {
+    DecodedMessage decoded{};
+    if (message->limit() < 4) {
+        decoded.text.assign((const char *) message->bytes(), message->limit());
+        return decoded;
+    }
+    decoded.constructor = (uint32_t) message->read_int(error);
+    decoded.id = message->read_long(error);
+    decoded.text = message->read_string(error);
+    return decoded;
+}
+
+CHECK(message_index_parallel_decode) {
+    const uint32_t count = 5000;
+    ProtoBuffer *buffer = container(count, true);
+    MessageIndex index;
+    EXPECT(index.scan(buffer));
+
+    std::vector<DecodedMessage> serial;
+    for (uint32_t a = 0; a < index.size(); a++) {
+        ProtoBuffer message(index.bytes(a), index.entry(a).length);
+        bool error = false;
+        serial.push_back(decode_message(&message, &error));
+        EXPECT(!error);
+    }
+
+    for (uint32_t threads : {1u, 3u, 0u}) {
+        ThreadPool pool(threads);
+        std::vector<DecodedMessage> results;
+        bool error = false;
+        EXPECT(index.decode(pool, &results, decode_message, &error));
+        EXPECT(!error);
+        EXPECT(results.size() == serial.size());
+        bool same = results.size() == serial.size();
+        for (uint32_t a = 0; same && a < results.size(); a++) {
+            same = results[a].constructor == serial[a].constructor && results[a].id == serial[a].id &&
+                   results[a].text == serial[a].text;
+        }
+        EXPECT(same);
+    }
+
+    // One message that fails to decode fails the whole call.
+    ThreadPool pool(0);
+    std::vector<int64_t> ids;
+    bool error = false;
+    EXPECT(!index.decode(pool, &ids, [](ProtoBuffer *message, bool *message_error) {
+        if (message->limit() < 12) {
+            return (int64_t) 0;
+        }
+        message->read_int(message_error);
+        int64_t id = message->read_long(message_error);
+        if (id == 4321 * 1000003LL) {
+            *message_error = true;
+        }
+        return id;
+    }, &error));
+    EXPECT(error);
+
+    // An empty index decodes to nothing.
+    MessageIndex empty;
+    ids.push_back(1);
+    error = false;
+    EXPECT(empty.decode(pool, &ids, [](ProtoBuffer *, bool *) { return (int64_t) 0; }, &error));
+    EXPECT(!error && ids.empty());
+    buffer->reuse();
+}
@@ -0,0 +1,91 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "ProtoBuffer.h"
+#include "ResponseCache.h"
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static ProtoBuffer *filled(const std::string &content) {
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer((uint32_t) content.size());
+    buffer->write_bytes((uint8_t *) content.data(), (uint32_t) content.size());
+    buffer->flip();
+    return buffer;
+}
+
+static std::string drain(ByteStream *stream, uint32_t step) {
+    std::string result;
+    uint8_t bytes[64];
+    ProtoBuffer dst(bytes, step < sizeof(bytes) ? step : sizeof(bytes));
+    while (stream->has_data()) {
+        dst.clear();
+        stream->get(&dst);
+        result.append((const char *) bytes, dst.position());
+        stream->discard(dst.position());
+    }
+    return result;
+}
+
+CHECK(response_cache_shared_segments) {
+    ResponseCache cache;
+    ResponseCache::Entry entry = cache.put(1, filled("shared response bytes"));
+    ByteStream first;
+    ByteStream second;
+    first.append(filled("<"));
+    EXPECT(cache.append_to(1, &first));
+    first.append(filled(">"));
+    EXPECT(cache.append_to(1, &second));
+    EXPECT(cache.append_to(1, &second));
+
+    // Each stream keeps its own offset into the shared bytes.
+    EXPECT(drain(&first, 5) == "<shared response bytes>");
+    EXPECT(drain(&second, 7) == "shared response bytesshared response bytes");
+    EXPECT(entry->position() == 0 && entry->remaining() == 21);
+
+    int fds[2];
+    EXPECT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    EXPECT(cache.append_to(1, &first));
+    first.discard(7);
+    bool error = false;
+    EXPECT(first.send_to(fds[0], &error) == 14 && !error);
+    char received[32] = {};
+    EXPECT(read(fds[1], received, sizeof(received)) == 14);
+    EXPECT(memcmp(received, "response bytes", 14) == 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    // The stream's reference outlives eviction.
+    EXPECT(cache.append_to(1, &second));
+    cache.remove(1);
+    entry.reset();
+    EXPECT(drain(&second, 64) == "shared response bytes");
+}
+
+CHECK(response_cache_content_key_collision) {
+    ResponseCache cache;
+    ProtoBuffer *content = filled("content addressed");
+    uint64_t key = ResponseCache::content_key(content);
+    // A caller key equal to the content hash stands in for an XXH64 collision.
+    cache.put(key, filled("something else"));
+    uint64_t returned = 0;
+    ResponseCache::Entry entry = cache.put(content, &returned);
+    EXPECT(entry != nullptr && entry->remaining() == 17);
+    EXPECT(returned == 0);
+    ResponseCache::Entry cached = cache.find(key);
+    EXPECT(cached != nullptr && cached->remaining() == 14);
+    EXPECT(cache.size() == 1);
+
+    ProtoBuffer *again = filled("content addressed");
+    cache.remove(key);
+    entry = cache.put(again, &returned);
+    EXPECT(returned == key);
+    EXPECT(cache.find(key) == entry);
+}
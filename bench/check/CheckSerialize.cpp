@@ -0,0 +1,168 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "Serialize.h"
+
+struct CheckPoint {
+    int32_t x;
+    int32_t y;
+    BUFFER_FIELDS(x, y)
+};
+
+struct CheckLabel {
+    bool visible;
+    std::string text;
+    BUFFER_FIELDS(visible, text)
+};
+
+struct CheckRecord {
+    int64_t id;
+    uint32_t flags;
+    double score;
+    bool active;
+    CheckPoint origin;
+    std::string name;
+    std::vector<uint8_t> blob;
+    std::vector<int64_t> samples;
+    std::vector<CheckPoint> path;
+    std::vector<std::string> tags;
+    std::vector<CheckLabel> labels;
+    std::vector<std::vector<int32_t>> nested;
+    BUFFER_FIELDS(id, flags, score, active, origin, name, blob, samples, path, tags, labels, nested)
+};
+
+static CheckRecord sample_record() {
+    CheckRecord record;
+    record.id = -7000000000LL;
+    record.flags = 0xdeadbeef;
+    record.score = -2.5;
+    record.active = true;
+    record.origin = {3, -4};
+    record.name = "serialize check";
+    record.blob = {0, 1, 0xff, 0x80, 7};
+    for (int64_t a = 0; a < 300; a++) {
+        record.samples.push_back(a * 1000003 - 17);
+    }
+    for (int32_t a = 0; a < 200; a++) {
+        record.path.push_back({a, -a});
+    }
+    record.tags = {"", "a", "abcd", std::string(300, 'x')};
+    record.labels = {{true, "on"}, {false, ""}};
+    record.nested = {{}, {1}, {2, 3, 4}};
+    return record;
+}
+
+static bool same(const CheckRecord &a, const CheckRecord &b) {
+    if (a.path.size() != b.path.size() || a.labels.size() != b.labels.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.path.size(); i++) {
+        if (a.path[i].x != b.path[i].x || a.path[i].y != b.path[i].y) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.labels.size(); i++) {
+        if (a.labels[i].visible != b.labels[i].visible || a.labels[i].text != b.labels[i].text) {
+            return false;
+        }
+    }
+    return a.id == b.id && a.flags == b.flags && a.score == b.score && a.active == b.active &&
+           a.origin.x == b.origin.x && a.origin.y == b.origin.y && a.name == b.name && a.blob == b.blob &&
+           a.samples == b.samples && a.tags == b.tags && a.nested == b.nested;
+}
+
+CHECK(serialize_round_trip) {
+    CheckRecord record = sample_record();
+    ProtoBuffer buffer(record.size());
+    bool error = false;
+    record.serialize(&buffer, &error);
+    EXPECT(!error);
+    EXPECT(buffer.position() == record.size());
+
+    buffer.flip();
+    CheckRecord decoded{};
+    EXPECT(decoded.deserialize(&buffer, &error));
+    EXPECT(!error);
+    EXPECT(!buffer.has_remaining());
+    EXPECT(same(record, decoded));
+}
+
+CHECK(serialize_truncated_input) {
+    CheckRecord record = sample_record();
+    uint32_t size = record.size();
+    ProtoBuffer encoded(size);
+    record.serialize(&encoded);
+    // Every proper prefix must be refused, wherever it cuts.
+    for (uint32_t length = 0; length < size; length += length < 64 ? 1 : 37) {
+        ProtoBuffer buffer(encoded.bytes(), length);
+        CheckRecord decoded{};
+        bool error = false;
+        EXPECT(!decoded.deserialize(&buffer, &error));
+        EXPECT(error);
+    }
+}
+
+CHECK(serialize_bad_bool) {
+    CheckLabel label{true, "text"};
+    ProtoBuffer buffer(label.size());
+    label.serialize(&buffer);
+    buffer.position(0);
+    buffer.write_int((uint32_t) 0x12345678);
+    buffer.flip();
+    buffer.limit(label.size());
+    CheckLabel decoded{};
+    bool error = false;
+    EXPECT(!decoded.deserialize(&buffer, &error));
+    EXPECT(error);
+}
+
+struct CheckTags {
+    std::vector<std::string> tags;
+    BUFFER_FIELDS(tags)
+};
+
+struct CheckLabels {
+    std::vector<CheckLabel> labels;
+    BUFFER_FIELDS(labels)
+};
+
+CHECK(serialize_forged_count) {
+    // 4096 input bytes claiming more strings than could fit: each needs at least 4 bytes.
+    ProtoBuffer buffer((uint32_t) 4096);
+    buffer.write_int((uint32_t) 0x1cb5c415);
+    buffer.write_int((uint32_t) 4000);
+    while (buffer.has_remaining()) {
+        buffer.write_byte(0);
+    }
+    buffer.flip();
+    CheckTags tags;
+    bool error = false;
+    EXPECT(!tags.deserialize(&buffer, &error));
+    EXPECT(error);
+    EXPECT(tags.tags.capacity() == 0);
+
+    // The same count of labels, each at least 8 bytes (Bool + empty string).
+    buffer.position(4);
+    buffer.write_int((uint32_t) 600);
+    buffer.position(0);
+    buffer.limit(4096);
+    CheckLabels labels;
+    error = false;
+    EXPECT(!labels.deserialize(&buffer, &error));
+    EXPECT(error);
+    EXPECT(labels.labels.capacity() == 0);
+
+    // A count that fits is read: zero bytes decode as empty strings, 4 bytes each.
+    buffer.position(4);
+    buffer.write_int((uint32_t) 1000);
+    buffer.position(0);
+    buffer.limit(4096);
+    error = false;
+    EXPECT(tags.deserialize(&buffer, &error));
+    EXPECT(!error);
+    EXPECT(tags.tags.size() == 1000);
+}
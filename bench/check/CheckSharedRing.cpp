@@ -0,0 +1,63 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "ProtoBuffer.h"
+#include "SharedRing.h"
+#include <unistd.h>
+
+#ifdef __linux__
+
+// Offsets of slot_size, slot_count and stride in the ring header.
+static const off_t slot_size_offset = 4;
+static const off_t slot_count_offset = 8;
+static const off_t stride_offset = 12;
+
+static bool attach_with(SharedRing *ring, off_t offset, uint32_t value) {
+    uint32_t saved = 0;
+    if (pread(ring->fd(), &saved, sizeof(saved), offset) != sizeof(saved) ||
+        pwrite(ring->fd(), &value, sizeof(value), offset) != sizeof(value)) {
+        return false;
+    }
+    bool error = false;
+    SharedRing *peer = SharedRing::attach(ring->fd(), &error);
+    delete peer;
+    if (pwrite(ring->fd(), &saved, sizeof(saved), offset) != sizeof(saved)) {
+        return false;
+    }
+    return peer != nullptr && !error;
+}
+
+CHECK(shared_ring_attach) {
+    SharedRing *ring = SharedRing::create(100, 8);
+    EXPECT(ring != nullptr);
+    if (ring == nullptr) {
+        return;
+    }
+    SharedRing *peer = SharedRing::attach(ring->fd());
+    EXPECT(peer != nullptr);
+    if (peer != nullptr) {
+        EXPECT(peer->slot_size() == 100 && peer->slot_count() == 8);
+        ProtoBuffer *slot = ring->begin_write();
+        slot->write_int(42);
+        ring->commit_write();
+        ProtoBuffer *read = peer->begin_read();
+        EXPECT(read != nullptr && read->read_int() == 42);
+        peer->commit_read();
+        delete peer;
+    }
+
+    // A header whose geometry doesn't fit the mapping or the slot layout is refused.
+    EXPECT(attach_with(ring, slot_size_offset, 100));
+    EXPECT(!attach_with(ring, slot_size_offset, 4096));
+    EXPECT(!attach_with(ring, slot_count_offset, 6));
+    EXPECT(!attach_with(ring, slot_count_offset, 0));
+    EXPECT(!attach_with(ring, stride_offset, 100));
+    EXPECT(!attach_with(ring, stride_offset, 64));
+    delete ring;
+}
+
+#endif
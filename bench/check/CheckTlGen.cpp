@@ -0,0 +1,124 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+
+#ifdef TKS_BUFFER_CHECK_TLGEN
+
+#include "BuffersStorage.h"
+#include "CheckSchema.h"
+#include "ProtoBuffer.h"
+
+static check_tl::history sample_history() {
+    check_tl::history history;
+    for (int32_t a = 0; a < 3; a++) {
+        check_tl::message message;
+        message.id = 100 + a;
+        message.out = a == 1;
+        message.pinned = a == 2;
+        message.from = check_tl::peerUser{1000 + a};
+        message.date = 1650000000 + a;
+        message.text = "message " + std::to_string(a);
+        check_tl::entity entity;
+        entity.offset = a;
+        entity.length = 4;
+        if (a != 0) {
+            entity.url = "https://example.com/" + std::to_string(a);
+        }
+        message.entities.push_back(entity);
+        if (a == 1) {
+            message.reply_to = 100;
+            message.geo = check_tl::geo{48.85, 2.35, 10};
+        }
+        if (a == 2) {
+            message.media = std::vector<uint8_t>{0, 1, 2, 0xff};
+        }
+        history.messages.push_back(message);
+    }
+    history.peers = {check_tl::peerUser{1000}, check_tl::peerChat{-42}};
+    history.ids = {1, -2, 1LL << 40};
+    history.scores = {0.5, -1.25};
+    history.tags = {"a", "", "longer tag"};
+    history.path = {check_tl::point{1, 2}, check_tl::point{-3, 4}};
+    history.read = {true, false, true};
+    history.complete = true;
+    return history;
+}
+
+static bool same(const check_tl::message &a, const check_tl::message &b) {
+    if (a.id != b.id || a.out != b.out || a.pinned != b.pinned || a.date != b.date || a.text != b.text ||
+        a.from.index() != b.from.index() || a.entities.size() != b.entities.size() ||
+        a.reply_to != b.reply_to || a.geo.has_value() != b.geo.has_value() || a.media != b.media) {
+        return false;
+    }
+    if (a.geo && (a.geo->lat != b.geo->lat || a.geo->long_ != b.geo->long_ || a.geo->accuracy != b.geo->accuracy)) {
+        return false;
+    }
+    for (size_t e = 0; e < a.entities.size(); e++) {
+        if (a.entities[e].offset != b.entities[e].offset || a.entities[e].length != b.entities[e].length ||
+            a.entities[e].url != b.entities[e].url) {
+            return false;
+        }
+    }
+    return true;
+}
+
+CHECK(tlgen_round_trip) {
+    check_tl::history in = sample_history();
+    uint32_t size = in.size_boxed();
+    ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size);
+    bool error = false;
+    in.serialize_boxed(buffer, &error);
+    EXPECT(!error);
+    EXPECT(buffer->position() == size);
+
+    buffer->flip();
+    check_tl::history out;
+    EXPECT(buffer->read_u_int() == check_tl::history::constructor);
+    out.deserialize(buffer, &error);
+    EXPECT(!error);
+    EXPECT(!buffer->has_remaining());
+    EXPECT(out.messages.size() == in.messages.size());
+    for (size_t a = 0; a < in.messages.size() && a < out.messages.size(); a++) {
+        EXPECT(same(in.messages[a], out.messages[a]));
+    }
+    EXPECT(out.peers.size() == 2 && std::get<check_tl::peerChat>(out.peers[1]).chat_id == -42);
+    EXPECT(out.ids == in.ids && out.scores == in.scores && out.tags == in.tags && out.read == in.read);
+    EXPECT(out.path.size() == 2 && out.path[1].x == -3 && out.path[1].y == 4);
+    EXPECT(out.complete);
+    buffer->reuse();
+
+    EXPECT(check_tl::point::has_fixed_size && check_tl::point::fixed_size == 8);
+    EXPECT(check_tl::geo::fixed_size == 20);
+    EXPECT(!check_tl::message::has_fixed_size);
+
+    check_tl::getHistory request;
+    request.peer = check_tl::peerChat{7};
+    request.limit = 50;
+    EXPECT(request.size_boxed() == 4 + 4 + 8 + 4 + 4);
+}
+
+CHECK(tlgen_vector_count_bound) {
+    // history with empty messages and peers, then ids claiming 4 longs with only one present:
+    // refused before the vector is sized, not after.
+    uint8_t bytes[64];
+    ProtoBuffer buffer(bytes, sizeof(bytes));
+    buffer.write_int((int32_t) check_tl::tl_vector);
+    buffer.write_int(0);
+    buffer.write_int((int32_t) check_tl::tl_vector);
+    buffer.write_int(0);
+    buffer.write_int((int32_t) check_tl::tl_vector);
+    buffer.write_int(4);
+    buffer.write_long(1);
+    buffer.flip();
+    check_tl::history history;
+    bool error = false;
+    history.deserialize(&buffer, &error);
+    EXPECT(error);
+    EXPECT(history.ids.capacity() < 4);
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "ProtoBuffer.h"
+#include "Utf8.h"
+#include <string>
+#include <vector>
+
+/*
+ * Decodes every code point and checks it against the Unicode rules directly, as an
+ * independent reference for the table-driven validator.
+ */
+static bool reference_valid(const uint8_t *data, uint32_t len) {
+    for (uint32_t a = 0; a < len;) {
+        uint32_t lead = data[a];
+        uint32_t count;
+        uint32_t code_point;
+        if (lead < 0x80) {
+            a++;
+            continue;
+        } else if ((lead & 0xe0) == 0xc0) {
+            count = 1;
+            code_point = lead & 0x1f;
+        } else if ((lead & 0xf0) == 0xe0) {
+            count = 2;
+            code_point = lead & 0x0f;
+        } else if ((lead & 0xf8) == 0xf0) {
+            count = 3;
+            code_point = lead & 0x07;
+        } else {
+            return false;
+        }
+        if (a + count >= len) {
+            return false;
+        }
+        for (uint32_t b = 1; b <= count; b++) {
+            if ((data[a + b] & 0xc0) != 0x80) {
+                return false;
+            }
+            code_point = code_point << 6 | (data[a + b] & 0x3f);
+        }
+        uint32_t min = count == 1 ? 0x80 : count == 2 ? 0x800 : 0x10000;
+        if (code_point < min || code_point > 0x10ffff || (code_point >= 0xd800 && code_point <= 0xdfff)) {
+            return false;
+        }
+        a += count + 1;
+    }
+    return true;
+}
+
+static bool validate(const std::string &text) {
+    return utf8_validate((const uint8_t *) text.data(), (uint32_t) text.size());
+}
+
+CHECK(utf8_rejects_malformed) {
+    const std::vector<std::string> valid = {
+            "", "ascii", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf", "\xee\x80\x80",
+            "\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf", "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80"};
+    const std::vector<std::string> invalid = {
+            // Overlong forms.
+            "\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xe0\x9f\xbf", "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf",
+            // Surrogates.
+            "\xed\xa0\x80", "\xed\xbf\xbf",
+            // Above U+10FFFF, and leads that can't start anything.
+            "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xf8\x88\x80\x80\x80", "\xff",
+            // Stray continuations and truncated sequences.
+            "\x80", "\xbf", "\xc2", "\xe2\x82", "\xf0\x9f\x98", "\xe2\x28\xa1", "\xc2\xc2\x80"};
+    for (const std::string &text : valid) {
+        EXPECT(validate(text));
+        EXPECT(reference_valid((const uint8_t *) text.data(), (uint32_t) text.size()));
+    }
+    for (const std::string &text : invalid) {
+        EXPECT(!validate(text));
+        EXPECT(!reference_valid((const uint8_t *) text.data(), (uint32_t) text.size()));
+    }
+}
+
+CHECK(utf8_vector_boundaries) {
+    const std::vector<std::string> sequences = {
+            "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xc0\x80", "\xed\xa0\x80", "\xf4\x90\x80\x80"};
+    // Each sequence, whole or cut short, placed so it starts just before, on and just after
+    // the 16- and 32-byte boundaries the ASCII skip works in, with and without a tail.
+    for (const std::string &sequence : sequences) {
+        for (uint32_t cut = 1; cut <= sequence.size(); cut++) {
+            for (uint32_t lead = 0; lead < 70; lead++) {
+                for (uint32_t tail : {0u, 1u, 40u}) {
+                    std::string text = std::string(lead, 'a') + sequence.substr(0, cut) + std::string(tail, 'z');
+                    bool expected = reference_valid((const uint8_t *) text.data(), (uint32_t) text.size());
+                    EXPECT(validate(text) == expected);
+                    if (validate(text) != expected) {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+CHECK(utf8_matches_reference) {
+    uint64_t state = 0x2545f4914f6cdd1dull;
+    uint8_t bytes[96];
+    for (uint32_t a = 0; a < 200000; a++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        auto len = (uint32_t) (state % sizeof(bytes));
+        for (uint32_t b = 0; b < len; b++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            // Mostly ASCII, with lead and continuation bytes sprinkled in.
+            uint32_t kind = (uint32_t) (state >> 60);
+            bytes[b] = kind < 10 ? (uint8_t) ((state >> 8) & 0x7f)
+                                 : kind < 13 ? (uint8_t) (0x80 | ((state >> 8) & 0x3f))
+                                             : (uint8_t) (0xc0 | ((state >> 8) & 0x3f));
+        }
+        bool expected = reference_valid(bytes, len);
+        EXPECT(utf8_validate(bytes, len) == expected);
+        if (utf8_validate(bytes, len) != expected) {
+            break;
+        }
+    }
+}
+
+CHECK(utf8_read_string) {
+    uint8_t bytes[64];
+    for (const std::string &text : {std::string("caf\xc3\xa9"), std::string("bad \xed\xa0\x80")}) {
+        ProtoBuffer buffer(bytes, sizeof(bytes));
+        buffer.write_string(text);
+        buffer.flip();
+        buffer.validate_utf8(true);
+        bool error = false;
+        std::string read = buffer.read_string(&error);
+        bool valid = validate(text);
+        EXPECT(error == !valid);
+        EXPECT(!valid || read == text);
+
+        buffer.position(0);
+        buffer.validate_utf8(false);
+        error = false;
+        EXPECT(buffer.read_string(&error) == text && !error);
+    }
+}
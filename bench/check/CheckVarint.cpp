@@ -0,0 +1,184 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "ProtoBuffer.h"
+#include "Varint.h"
+#include <cstring>
+#include <vector>
+
+typedef ProtoBuffer::WireType WireType;
+
+static std::vector<uint64_t> boundary_values() {
+    std::vector<uint64_t> values = {0, 1, 0x7f, UINT64_MAX, UINT64_MAX - 1};
+    for (uint32_t bits = 7; bits < 64; bits += 7) {
+        values.push_back((1ull << bits) - 1);
+        values.push_back(1ull << bits);
+        values.push_back((1ull << bits) + 1);
+    }
+    return values;
+}
+
+CHECK(varint_lengths_1_to_10) {
+    for (uint64_t value : boundary_values()) {
+        // Continuation bits set after the varint, so an over-long decode would be noticed.
+        uint8_t bytes[24];
+        memset(bytes, 0xff, sizeof(bytes));
+        uint32_t length = varint_encode(bytes, value);
+        EXPECT(length == varint_size(value));
+        EXPECT(length == ProtoBuffer::varint_size(value));
+
+        uint64_t fast = 0;
+        uint64_t slow = 0;
+        EXPECT(varint_decode_fast(bytes, sizeof(bytes), &fast) == length);
+        EXPECT(varint_decode_slow(bytes, sizeof(bytes), &slow) == length);
+        EXPECT(fast == value && slow == value);
+
+        ProtoBuffer buffer(bytes, sizeof(bytes));
+        bool error = false;
+        EXPECT(buffer.read_varint(&error) == value);
+        EXPECT(!error && buffer.position() == length);
+    }
+    uint8_t ten[varint_max_size];
+    EXPECT(varint_encode(ten, UINT64_MAX) == 10);
+    EXPECT(varint_encode(ten, 1ull << 56) == 9);
+}
+
+CHECK(varint_fast_matches_loop) {
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    uint8_t bytes[16];
+    for (uint32_t a = 0; a < 200000; a++) {
+        for (uint8_t &byte : bytes) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            // Three in four bytes continue, so every length up to 10 and beyond comes up.
+            byte = (uint8_t) (state >> 24) | ((state & 3) != 0 ? 0x80 : 0);
+        }
+        uint64_t fast = 0;
+        uint64_t slow = 0;
+        uint32_t fast_length = varint_decode_fast(bytes, sizeof(bytes), &fast);
+        uint32_t slow_length = varint_decode_slow(bytes, sizeof(bytes), &slow);
+        EXPECT(fast_length == slow_length);
+        EXPECT(fast_length == 0 || fast == slow);
+        if (fast_length != slow_length || (fast_length != 0 && fast != slow)) {
+            break;
+        }
+    }
+}
+
+CHECK(varint_short_tails) {
+    for (uint64_t value : boundary_values()) {
+        uint8_t encoded[varint_max_size];
+        uint32_t length = varint_encode(encoded, value);
+        if (length >= 8) {
+            continue;
+        }
+        // The varint is the last thing in the buffer, with fewer than 8 bytes readable.
+        for (uint32_t lead = 0; lead + length < 8; lead++) {
+            uint8_t bytes[8] = {};
+            memcpy(bytes + lead, encoded, length);
+            ProtoBuffer buffer(bytes, lead + length);
+            buffer.position(lead);
+            bool error = false;
+            EXPECT(buffer.read_varint(&error) == value);
+            EXPECT(!error && !buffer.has_remaining());
+
+            // One byte short is truncated.
+            ProtoBuffer truncated(bytes, lead + length - 1);
+            truncated.position(lead);
+            error = false;
+            truncated.read_varint(&error);
+            EXPECT(error);
+            EXPECT(truncated.position() == lead);
+        }
+    }
+}
+
+CHECK(varint_malformed) {
+    // 11 bytes: the 10th still has its continuation bit set.
+    uint8_t bytes[16];
+    memset(bytes, 0xff, sizeof(bytes));
+    bytes[10] = 0x01;
+    uint64_t value = 0;
+    EXPECT(varint_decode_fast(bytes, sizeof(bytes), &value) == 0);
+    EXPECT(varint_decode_slow(bytes, sizeof(bytes), &value) == 0);
+    ProtoBuffer buffer(bytes, sizeof(bytes));
+    bool error = false;
+    buffer.read_varint(&error);
+    EXPECT(error);
+    EXPECT(buffer.position() == 0);
+
+    // Ten continuation bytes and a long tail, inside the fast path's 8-byte window too.
+    memset(bytes, 0x80, sizeof(bytes));
+    EXPECT(varint_decode_fast(bytes, sizeof(bytes), &value) == 0);
+}
+
+CHECK(varint_zigzag_extremes) {
+    EXPECT(zigzag_encode(0) == 0);
+    EXPECT(zigzag_encode(-1) == 1);
+    EXPECT(zigzag_encode(INT64_MAX) == UINT64_MAX - 1);
+    EXPECT(zigzag_encode(INT64_MIN) == UINT64_MAX);
+    for (int64_t value : {(int64_t) 0, (int64_t) -1, (int64_t) 1, INT64_MAX, INT64_MIN, INT64_MIN + 1}) {
+        EXPECT(zigzag_decode(zigzag_encode(value)) == value);
+        uint8_t bytes[16] = {};
+        ProtoBuffer buffer(bytes, sizeof(bytes));
+        buffer.write_zigzag(value);
+        buffer.flip();
+        bool error = false;
+        EXPECT(buffer.read_zigzag(&error) == value);
+        EXPECT(!error);
+    }
+}
+
+CHECK(varint_tags_and_skip) {
+    uint8_t bytes[64];
+    for (uint32_t wire = 0; wire < 8; wire++) {
+        for (uint64_t field : {(uint64_t) 0, (uint64_t) 1, (uint64_t) 0x1fffffff, (uint64_t) 0x20000000}) {
+            memset(bytes, 0, sizeof(bytes));
+            uint32_t length = varint_encode(bytes, field << 3 | wire);
+            ProtoBuffer buffer(bytes, length);
+            WireType type;
+            bool error = false;
+            uint32_t read = buffer.read_tag(&type, &error);
+            bool valid = field != 0 && field <= 0x1fffffff && (wire == 0 || wire == 1 || wire == 2 || wire == 5);
+            EXPECT(error == !valid);
+            if (valid) {
+                EXPECT(read == field && (uint32_t) type == wire);
+            }
+        }
+    }
+
+    // One field of each wire type, skipped in turn.
+    ProtoBuffer buffer(bytes, sizeof(bytes));
+    buffer.write_tag(1, WireType::varint);
+    buffer.write_varint(UINT64_MAX);
+    buffer.write_tag(2, WireType::fixed64);
+    buffer.write_long(-5);
+    buffer.write_tag(3, WireType::length_delimited);
+    buffer.write_varint(3);
+    buffer.write_bytes((uint8_t *) "abc", 3);
+    buffer.write_tag(4, WireType::fixed32);
+    buffer.write_int(7);
+    buffer.flip();
+    bool error = false;
+    for (uint32_t field = 1; field <= 4; field++) {
+        WireType type;
+        EXPECT(buffer.read_tag(&type, &error) == field);
+        buffer.skip_field(type, &error);
+    }
+    EXPECT(!error && !buffer.has_remaining());
+
+    // A fixed64 with only 4 bytes left.
+    buffer.position(0);
+    buffer.limit(1 + 10 + 1 + 4);
+    for (uint32_t field = 1; field <= 2; field++) {
+        WireType type;
+        buffer.read_tag(&type, &error);
+        buffer.skip_field(type, &error);
+    }
+    EXPECT(error);
+}
@@ -0,0 +1,96 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include "VectorEncoder.h"
+#include <string>
+#include <vector>
+
+struct EncodedItem {
+    int64_t id;
+    int32_t date;
+    std::string text;
+};
+
+static void encode_item(const EncodedItem &item, ProtoBuffer *buffer, bool *error) {
+    buffer->write_int((uint32_t) 0x2a9b0b3c, error);
+    buffer->write_long(item.id, error);
+    buffer->write_int(item.date, error);
+    buffer->write_string(item.text, error);
+}
+
+static std::string serial_encoding(const std::vector<EncodedItem> &items) {
+    ProtoBuffer sizer(true);
+    for (const EncodedItem &item : items) {
+        encode_item(item, &sizer, nullptr);
+    }
+    ProtoBuffer buffer(sizer.capacity() + 8);
+    buffer.write_int((uint32_t) 0x1cb5c415);
+    buffer.write_int((uint32_t) items.size());
+    for (const EncodedItem &item : items) {
+        encode_item(item, &buffer, nullptr);
+    }
+    return std::string((const char *) buffer.bytes(), buffer.position());
+}
+
+static std::string drain(ByteStream *stream) {
+    std::string result;
+    ProtoBuffer *chunk = BuffersStorage::get().get_free_buffer(16384);
+    while (stream->has_data()) {
+        chunk->clear();
+        stream->get(chunk);
+        result.append((const char *) chunk->bytes(), chunk->position());
+        stream->discard(chunk->position());
+    }
+    chunk->reuse();
+    return result;
+}
+
+static std::vector<EncodedItem> make_items(uint32_t count, uint32_t large_every) {
+    std::vector<EncodedItem> items(count);
+    for (uint32_t a = 0; a < count; a++) {
+        items[a].id = (int64_t) a * 7919 - 3;
+        items[a].date = (int32_t) a;
+        // Mostly small items, with the odd one larger than a whole chunk.
+        uint32_t length = large_every != 0 && a % large_every == large_every - 1 ? 200000 : 16 + a % 300;
+        items[a].text.assign(length, (char) ('a' + a % 26));
+    }
+    return items;
+}
+
+CHECK(vector_encoder_matches_serial) {
+    for (uint32_t count : {0u, 1u, 15u, 17u, 1000u, 60000u}) {
+        for (uint32_t large_every : {0u, 997u}) {
+            std::vector<EncodedItem> items = make_items(count, large_every);
+            std::string expected = serial_encoding(items);
+            for (uint32_t threads : {1u, 0u}) {
+                ThreadPool pool(threads);
+                ByteStream stream;
+                bool error = false;
+                EXPECT(encode_vector(pool, items.data(), count, encode_item, &stream, &error));
+                EXPECT(!error);
+                EXPECT(drain(&stream) == expected);
+            }
+        }
+    }
+}
+
+CHECK(vector_encoder_failure) {
+    std::vector<EncodedItem> items = make_items(5000, 0);
+    ThreadPool pool(0);
+    ByteStream stream;
+    bool error = false;
+    // An item whose encoder always fails: nothing is appended.
+    EXPECT(!encode_vector(pool, items.data(), (uint32_t) items.size(), [](const EncodedItem &item, ProtoBuffer *buffer,
+                                                                        bool *item_error) {
+        encode_item(item, buffer, item_error);
+        if (item.date == 4000) {
+            *item_error = true;
+        }
+    }, &stream, &error));
+    EXPECT(error);
+    EXPECT(!stream.has_data());
+}
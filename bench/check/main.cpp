@@ -0,0 +1,38 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Check.h"
+#include <cstring>
+
+std::vector<CheckCase> &check_registry() {
+    static std::vector<CheckCase> registry;
+    return registry;
+}
+
+int &check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    for (const CheckCase &check : check_registry()) {
+        bool selected = argc < 2;
+        for (int a = 1; a < argc && !selected; a++) {
+            selected = strstr(check.name, argv[a]) != nullptr;
+        }
+        if (!selected) {
+            continue;
+        }
+        int before = check_failures();
+        check.run();
+        printf("%-48s %s\n", check.name, check_failures() == before ? "ok" : "FAIL");
+    }
+    if (check_failures() != 0) {
+        printf("%d expectation(s) failed\n", check_failures());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Bench.h"
+#include <cstring>
+
+std::vector<BenchCase> &bench_registry() {
+    static std::vector<BenchCase> registry;
+    return registry;
+}
+
+int main(int argc, char **argv) {
+    for (const BenchCase &bench : bench_registry()) {
+        bool selected = argc < 2;
+        for (int a = 1; a < argc && !selected; a++) {
+            selected = strstr(bench.name, argv[a]) != nullptr;
+        }
+        if (!selected) {
+            continue;
+        }
+        printf("== %s\n", bench.name);
+        bench.run();
+    }
+    return 0;
+}
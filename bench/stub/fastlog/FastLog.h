@@ -0,0 +1,20 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+/*
+ * No-op stand-in for the fastlog logging macros, used when the library is built with
+ * BUFFER_STUB_FASTLOG=ON (benchmarks and standalone builds).
+ */
+
+#ifndef TKS_FAST_LOG_STUB_H
+#define TKS_FAST_LOG_STUB_H
+
+#define DEBUG_D(...) ((void) 0)
+#define DEBUG_I(...) ((void) 0)
+#define DEBUG_W(...) ((void) 0)
+#define DEBUG_E(...) ((void) 0)
+
+#endif //TKS_FAST_LOG_STUB_H
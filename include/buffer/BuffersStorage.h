@@ -8,18 +8,100 @@
 #define TKS_BUFFERS_STORAGE_H
 
 #include "ProtoBuffer.h"
+#include <atomic>
 #include <memory>
+#include <string>
+#include <unordered_map>
 
 #include <vector>
 #include <cstdint>
 
+#define BUFFERS_STORAGE_STRINGIFY_(x) #x
+#define BUFFERS_STORAGE_STRINGIFY(x) BUFFERS_STORAGE_STRINGIFY_(x)
+
+/*
+ * "file:line" of the expansion, for the tag argument of get_free_buffer.
+ */
+#define BUFFER_SITE __FILE__ ":" BUFFERS_STORAGE_STRINGIFY(__LINE__)
+
 class BuffersStorage {
 public:
-    ProtoBuffer* get_free_buffer(uint32_t size);
+    /*
+     * Hold times of released buffers for one tag. Bucket i counts holds of [2^i, 2^(i+1))
+     * microseconds, bucket 0 everything below 2us, the last bucket everything above.
+     */
+    struct HoldHistogram {
+        static const uint32_t bucket_count = 32;
+        uint64_t count{0};
+        uint64_t total_ns{0};
+        uint64_t max_ns{0};
+        uint64_t buckets[bucket_count]{};
+    };
+
+    struct LiveBuffer {
+        std::string tag;
+        uint32_t size;
+        uint32_t capacity;
+        uint64_t age_ns;
+    };
+
+    /*
+     * tag names the caller in the tracing reports and must outlive the storage (a string
+     * literal, BUFFER_SITE). Untagged buffers are reported by the return address they were
+     * acquired from, as module+offset, which addr2line turns back into a source line.
+     */
+    ProtoBuffer* get_free_buffer(uint32_t size, const char *tag = nullptr);
     void reuse_free_buffer(ProtoBuffer *buffer);
     static BuffersStorage &get();
+
+    /*
+     * Opt-in lifetime tracing: with sample_rate N, one buffer in N handed out is recorded with
+     * its tag, size class and acquisition time until it comes back through reuse(). 0 turns
+     * recording off; buffers already recorded are still accounted for when released. When off
+     * the cost is one relaxed atomic load per get; reuse only takes the trace lock for buffers
+     * that were sampled.
+     */
+    void set_tracing(uint32_t sample_rate);
+
+    [[nodiscard]] uint32_t tracing() const;
+
+    /*
+     * Recorded buffers that were not released yet, oldest first.
+     */
+    std::vector<LiveBuffer> live_buffers();
+
+    std::vector<std::pair<std::string, HoldHistogram>> hold_histograms();
+
+    /*
+     * Text summary for logs: per tag, live count, bytes and oldest age, then hold-time
+     * percentiles, followed by the max_live oldest live buffers.
+     */
+    std::string tracing_report(uint32_t max_live = 32);
+
+    /*
+     * Forgets every record and histogram.
+     */
+    void reset_tracing();
+
 private:
+    struct Trace {
+        const char *tag;
+        const void *site;
+        uint32_t size;
+        uint32_t capacity;
+        uint64_t acquired_ns;
+    };
+
+    struct TagHistogram {
+        const char *tag;
+        const void *site;
+        HoldHistogram histogram;
+    };
+
     explicit BuffersStorage(bool thread_safe);
+    void trace_acquire(ProtoBuffer *buffer, uint32_t size, const char *tag, const void *site);
+    void trace_release(ProtoBuffer *buffer);
+    static std::string trace_name(const char *tag, const void *site);
     std::vector<std::unique_ptr<ProtoBuffer>> m_free_buffers8;
     std::vector<std::unique_ptr<ProtoBuffer>> m_free_buffers128;
     std::vector<std::unique_ptr<ProtoBuffer>> m_free_buffers1024;
@@ -30,5 +112,11 @@ private:
 
     bool m_is_thread_safe = true;
     pthread_mutex_t m_mutex{};
+
+    std::atomic<uint32_t> m_trace_rate{0};
+    pthread_mutex_t m_trace_mutex{};
+    std::unordered_map<ProtoBuffer *, Trace> m_traces;
+    // Keyed by tag, or by site for untagged buffers; merged by name in the reports.
+    std::unordered_map<const void *, TagHistogram> m_histograms;
 };
 #endif //TKS_BUFFERS_STORAGE_H
@@ -9,8 +9,13 @@
 
 #include <vector>
 #include <cstdint>
+#include <memory>
+
+struct iovec;
 
 class ProtoBuffer;
+class Crc32c;
+class XxHash64;
 
 class ByteStream {
 public:
@@ -20,16 +25,81 @@ public:
 
     void append(ProtoBuffer *buffer);
 
+    /*
+     * Queues the remaining bytes of a buffer shared with other streams, without copying or
+     * allocating. The stream keeps its own offset into them and holds a reference until they
+     * are discarded or the stream is cleaned; buffer must not be modified while shared.
+     */
+    void append_shared(const std::shared_ptr<const ProtoBuffer> &buffer);
+
+    /*
+     * Queues `length` bytes of fd starting at `offset` without reading them. The region is
+     * read with pread by get() and sent with sendfile by send_to(). With close_fd the
+     * descriptor is closed once the region is fully discarded or the stream is cleaned. An
+     * empty region is not queued, and with close_fd its descriptor is closed right away.
+     */
+    void append_file(int fd, uint64_t offset, uint32_t length, bool close_fd = false);
+
     bool has_data();
 
+    /*
+     * True when at least count bytes are queued; stops counting once it gets there.
+     */
+    bool has_data(uint32_t count);
+
     void get(ProtoBuffer *dst);
 
     void discard(uint32_t count);
 
     void clean();
 
+    /*
+     * Writes queued data to fd: runs of memory segments with writev, file regions with
+     * sendfile. Sent bytes are discarded. Stops early when fd would block and returns the
+     * number of bytes sent.
+     */
+    uint32_t send_to(int fd, bool *error = nullptr);
+
+    /*
+     * Fills iov with the remaining bytes of the leading memory segments, stopping at the first
+     * file region or after max_count entries, and returns the number of entries filled. The
+     * bytes stay queued until discard().
+     */
+    uint32_t prepare_iov(struct iovec *iov, uint32_t max_count, uint32_t *total = nullptr);
+
+    /*
+     * Folds the remaining bytes of every queued buffer into the checksum, in queue order,
+     * without consuming them.
+     */
+    void update_checksum(Crc32c *crc);
+
+    void update_checksum(XxHash64 *hash);
+
 private:
-    std::vector<ProtoBuffer *> m_buffers_queue;
+    struct Segment {
+        ProtoBuffer *buffer{nullptr};
+        int fd{-1};
+        bool close_fd{false};
+        uint64_t offset{0};
+        uint32_t length{0};
+        std::shared_ptr<const ProtoBuffer> shared;
+
+        [[nodiscard]] uint32_t remaining() const;
+
+        /*
+         * True for pooled and shared buffers, false for file regions.
+         */
+        [[nodiscard]] bool in_memory() const;
+
+        /*
+         * First remaining byte of an in-memory segment.
+         */
+        [[nodiscard]] uint8_t *data() const;
+    };
+
+    void release(Segment &segment);
+
+    std::vector<Segment> m_buffers_queue;
 };
 
 #endif //TKS_PROTO_BUFFER_BYTESTREAM_H
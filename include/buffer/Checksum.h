@@ -0,0 +1,85 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_CHECKSUM_H
+#define TKS_PROTO_BUFFER_CHECKSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+class ProtoBuffer;
+
+/*
+ * CRC32C (Castagnoli). Uses the SSE4.2 / ARMv8 crc32c instructions when the CPU has them and a
+ * slicing-by-8 table otherwise. Values are compatible with iSCSI, ext4 and leveldb crc32c.
+ */
+class Crc32c {
+public:
+    Crc32c() = default;
+
+    static uint32_t extend(uint32_t crc, const uint8_t *data, size_t len);
+
+    static uint32_t compute(const uint8_t *data, size_t len);
+
+    void update(const uint8_t *data, size_t len);
+
+    /*
+     * Folds in len bytes of buffer from offset. A range past the buffer's limit leaves the
+     * checksum unchanged and sets error.
+     */
+    void update(ProtoBuffer *buffer, uint32_t offset, uint32_t len, bool *error = nullptr);
+
+    /*
+     * Starts following the bytes written to buffer from its current position on. Every
+     * update_written() call folds in what was written since the previous call, so the checksum
+     * is produced while the data is still in cache.
+     */
+    void track(ProtoBuffer *buffer);
+
+    void update_written();
+
+    [[nodiscard]] uint32_t value() const;
+
+    void reset();
+
+private:
+    uint32_t m_crc{0};
+    ProtoBuffer *m_tracked{nullptr};
+    uint32_t m_mark{0};
+};
+
+/*
+ * 64-bit xxHash (XXH64), for fast non-cryptographic content hashes.
+ */
+class XxHash64 {
+public:
+    explicit XxHash64(uint64_t seed = 0);
+
+    static uint64_t compute(const uint8_t *data, size_t len, uint64_t seed = 0);
+
+    void update(const uint8_t *data, size_t len);
+
+    void update(ProtoBuffer *buffer, uint32_t offset, uint32_t len, bool *error = nullptr);
+
+    void track(ProtoBuffer *buffer);
+
+    void update_written();
+
+    [[nodiscard]] uint64_t value() const;
+
+    void reset(uint64_t seed = 0);
+
+private:
+    uint64_t m_acc[4]{};
+    uint64_t m_seed{0};
+    uint64_t m_total_len{0};
+    uint8_t m_mem[32]{};
+    uint32_t m_mem_size{0};
+    ProtoBuffer *m_tracked{nullptr};
+    uint32_t m_mark{0};
+};
+
+#endif //TKS_PROTO_BUFFER_CHECKSUM_H
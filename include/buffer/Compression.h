@@ -0,0 +1,95 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_COMPRESSION_H
+#define TKS_PROTO_BUFFER_COMPRESSION_H
+
+#include <cstdint>
+
+class ProtoBuffer;
+class ByteStream;
+
+enum class CompressionCodec : uint32_t {
+    stored = 0,
+    lz4 = 1,
+    zlib = 2
+};
+
+/*
+ * Compresses payloads into self-describing frames:
+ *
+ *   int32 codec | int32 raw length | int32 packed length | packed bytes
+ *
+ * lz4 is a built-in LZ4 block codec (format compatible with LZ4_decompress_safe), zlib uses
+ * the system zlib when the library was built with it. Payloads below the threshold, or that
+ * would not shrink, are framed as stored so the receiver always decodes the same way.
+ *
+ * Output goes into buffers from BuffersStorage, positioned for reading; the caller reuse()s
+ * them. A Compressor keeps its match table and deflate state between calls, so it is meant
+ * to be owned by one thread; decompression is stateless.
+ */
+class Compressor {
+public:
+    static const uint32_t header_size = 12;
+    static const uint32_t stream_block_size = 65536;
+
+    /*
+     * level is the lz4 acceleration (higher is faster and compresses less, at least 1) or the
+     * zlib level (0 to 9, or -1 for zlib's default); values out of range are clamped.
+     */
+    explicit Compressor(CompressionCodec codec = CompressionCodec::lz4, uint32_t threshold = 512,
+                        int32_t level = 1);
+
+    Compressor(Compressor &) = delete;
+    Compressor &operator=(Compressor const &) = delete;
+
+    ~Compressor();
+
+    static bool available(CompressionCodec codec);
+
+    /*
+     * Largest frame compress() can produce for `length` input bytes.
+     */
+    static uint32_t max_frame_size(uint32_t length);
+
+    /*
+     * Frames the remaining bytes of src without moving its position.
+     */
+    ProtoBuffer *compress(ProtoBuffer *src, bool *error = nullptr);
+
+    /*
+     * Fails for payloads above 256MB, the largest frame decompress() accepts; split them or
+     * use the ByteStream overload.
+     */
+    ProtoBuffer *compress(const uint8_t *data, uint32_t length, bool *error = nullptr);
+
+    /*
+     * Consumes everything queued in src and appends one frame per stream_block_size bytes to
+     * dst. Returns the number of input bytes consumed.
+     */
+    uint32_t compress(ByteStream *src, ByteStream *dst, bool *error = nullptr);
+
+    /*
+     * Reads one frame at src's position and returns the original payload.
+     */
+    static ProtoBuffer *decompress(ProtoBuffer *src, bool *error = nullptr);
+
+    /*
+     * Decodes every complete frame queued in src, appending the payloads to dst; a trailing
+     * partial frame stays queued, untouched, until the rest of it arrives. Returns the number
+     * of payload bytes produced.
+     */
+    static uint32_t decompress(ByteStream *src, ByteStream *dst, bool *error = nullptr);
+
+private:
+    CompressionCodec m_codec;
+    uint32_t m_threshold;
+    int32_t m_level;
+    uint32_t *m_table{nullptr};
+    void *m_zstream{nullptr};
+};
+
+#endif //TKS_PROTO_BUFFER_COMPRESSION_H
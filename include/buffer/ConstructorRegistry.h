@@ -0,0 +1,207 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_CONSTRUCTOR_REGISTRY_H
+#define TKS_PROTO_BUFFER_CONSTRUCTOR_REGISTRY_H
+
+#include "ProtoBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ * Maps 32-bit TL constructor ids to decode functions. Ids are registered once with add(), then
+ * build() lays them out in a perfect hash (hash and displace): the id picks a
+ * bucket, the bucket's displacement picks the slot, and every registered id lands in a slot
+ * of its own. A lookup is therefore two array reads and one compare, whatever the number of
+ * types, and decode() is that lookup plus one indirect call.
+ *
+ * add() and build() are not thread safe; once built, lookups can run from any thread.
+ */
+template<typename T>
+class ConstructorRegistry {
+public:
+    typedef T (*Decoder)(ProtoBuffer *buffer, uint32_t constructor, bool *error);
+
+    ConstructorRegistry() = default;
+
+    /*
+     * Registers a decoder; takes effect at the next build().
+     */
+    void add(uint32_t constructor, Decoder decoder) {
+        m_pending.emplace_back(constructor, decoder);
+    }
+
+    /*
+     * Builds the lookup table from every id added so far. Fails, leaving the previous table in
+     * place, when an id was added twice.
+     */
+    bool build(bool *error = nullptr) {
+        std::vector<std::pair<uint32_t, Decoder>> entries = m_pending;
+        std::sort(entries.begin(), entries.end(), [](const std::pair<uint32_t, Decoder> &a,
+                                                     const std::pair<uint32_t, Decoder> &b) {
+            return a.first < b.first;
+        });
+        for (size_t a = 1; a < entries.size(); a++) {
+            if (entries[a].first == entries[a - 1].first) {
+                if (error != nullptr) {
+                    *error = true;
+                }
+                DEBUG_E("constructor registry error: 0x%08x registered twice", entries[a].first);
+                return false;
+            }
+        }
+        auto count = (uint32_t) entries.size();
+        uint32_t slot_count = 1;
+        while (slot_count < count + count / 4 + 1) {
+            slot_count <<= 1;
+        }
+        uint32_t bucket_count = 1;
+        while (bucket_count < count / 2 + 1) {
+            bucket_count <<= 1;
+        }
+        while (!place(entries, slot_count, bucket_count)) {
+            slot_count <<= 1;
+        }
+        return true;
+    }
+
+    [[nodiscard]] uint32_t size() const {
+        return m_size;
+    }
+
+    /*
+     * Decoder registered for constructor, or nullptr.
+     */
+    [[nodiscard]] Decoder find(uint32_t constructor) const {
+        if (m_size == 0) {
+            return nullptr;
+        }
+        uint32_t displacement = m_displacements[mix(constructor) & m_bucket_mask];
+        const Slot &slot = m_slots[mix(constructor ^ displacement) & m_slot_mask];
+        return slot.constructor == constructor ? slot.decoder : nullptr;
+    }
+
+    /*
+     * Reads the constructor id at buffer's position and dispatches to its decoder. Unknown ids
+     * set error and return T().
+     */
+    T decode(ProtoBuffer *buffer, bool *error = nullptr) const {
+        bool read_error = false;
+        auto constructor = (uint32_t) buffer->read_int(&read_error);
+        if (read_error) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            return T();
+        }
+        return decode(buffer, constructor, error);
+    }
+
+    /*
+     * Dispatches on a constructor id the caller already read.
+     */
+    T decode(ProtoBuffer *buffer, uint32_t constructor, bool *error = nullptr) const {
+        Decoder decoder = find(constructor);
+        if (decoder == nullptr) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("constructor registry error: unknown constructor 0x%08x", constructor);
+            return T();
+        }
+        return decoder(buffer, constructor, error);
+    }
+
+private:
+    /*
+     * Free slots keep a null decoder, so an unknown id that happens to equal their constructor
+     * still resolves to nullptr.
+     */
+    struct Slot {
+        uint32_t constructor;
+        Decoder decoder;
+    };
+
+    static inline uint32_t mix(uint32_t h) {
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    /*
+     * Places the largest buckets first, trying displacements until all of a bucket's ids fall
+     * in distinct free slots. Gives up after a bounded search so build() can grow the table.
+     */
+    bool place(const std::vector<std::pair<uint32_t, Decoder>> &entries, uint32_t slot_count,
+               uint32_t bucket_count) {
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (uint32_t a = 0; a < entries.size(); a++) {
+            buckets[mix(entries[a].first) & (bucket_count - 1)].push_back(a);
+        }
+        std::vector<uint32_t> order(bucket_count);
+        for (uint32_t a = 0; a < bucket_count; a++) {
+            order[a] = a;
+        }
+        std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+            return buckets[a].size() > buckets[b].size();
+        });
+
+        std::vector<Slot> slots(slot_count, Slot{0, nullptr});
+        std::vector<bool> used(slot_count, false);
+        std::vector<uint32_t> displacements(bucket_count, 0);
+        std::vector<uint32_t> taken;
+        for (uint32_t bucket : order) {
+            if (buckets[bucket].empty()) {
+                break;
+            }
+            bool placed = false;
+            for (uint32_t displacement = 0; displacement < 4096 && !placed; displacement++) {
+                uint32_t salt = displacement * 0x9e3779b9u;
+                taken.clear();
+                placed = true;
+                for (uint32_t index : buckets[bucket]) {
+                    uint32_t slot = mix(entries[index].first ^ salt) & (slot_count - 1);
+                    if (used[slot] || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+                        placed = false;
+                        break;
+                    }
+                    taken.push_back(slot);
+                }
+                if (placed) {
+                    for (uint32_t a = 0; a < taken.size(); a++) {
+                        uint32_t index = buckets[bucket][a];
+                        used[taken[a]] = true;
+                        slots[taken[a]] = Slot{entries[index].first, entries[index].second};
+                    }
+                    displacements[bucket] = salt;
+                }
+            }
+            if (!placed) {
+                return false;
+            }
+        }
+        m_slots.swap(slots);
+        m_displacements.swap(displacements);
+        m_slot_mask = slot_count - 1;
+        m_bucket_mask = bucket_count - 1;
+        m_size = (uint32_t) entries.size();
+        return true;
+    }
+
+    std::vector<std::pair<uint32_t, Decoder>> m_pending;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_displacements;
+    uint32_t m_slot_mask{0};
+    uint32_t m_bucket_mask{0};
+    uint32_t m_size{0};
+};
+
+#endif //TKS_PROTO_BUFFER_CONSTRUCTOR_REGISTRY_H
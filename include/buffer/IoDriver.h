@@ -0,0 +1,131 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_IO_DRIVER_H
+#define TKS_PROTO_BUFFER_IO_DRIVER_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class ByteStream;
+class ProtoBuffer;
+
+/*
+ * Socket receive/send loop on top of BuffersStorage and ByteStream.
+ *
+ * With io_uring, a set of pooled buffers is registered as fixed buffers and the kernel
+ * receives straight into them; a filled buffer is appended to the connection's input
+ * ByteStream as is and its slot is re-registered with a fresh pooled buffer. Sends are
+ * submitted as one sendmsg over the output stream's segments and the sent bytes are discarded
+ * on completion. When io_uring is unavailable (or not wanted) the same API runs on epoll,
+ * still reading into pooled buffers and writing with ByteStream::send_to.
+ *
+ * The driver is not thread safe; every call, including the delegate callbacks, happens on
+ * the thread calling poll().
+ */
+class IoDriver {
+public:
+    class Delegate {
+    public:
+        virtual ~Delegate() = default;
+
+        virtual void on_data_received(int fd, ByteStream *input, uint32_t count) = 0;
+
+        virtual void on_data_sent(int /*fd*/, uint32_t /*count*/) {
+        }
+
+        /*
+         * error is 0 for an orderly shutdown by the peer, an errno value otherwise. The
+         * connection is already removed from the driver when this is called.
+         */
+        virtual void on_connection_closed(int fd, int error) = 0;
+    };
+
+    static IoDriver *create(Delegate *delegate, uint32_t buffer_size = 16384, uint32_t queue_depth = 64,
+                            bool use_io_uring = true, bool *error = nullptr);
+
+    IoDriver(IoDriver &) = delete;
+    IoDriver &operator=(IoDriver const &) = delete;
+
+    ~IoDriver();
+
+    [[nodiscard]] bool uses_io_uring() const;
+
+    /*
+     * Starts receiving from fd into input. fd should be non-blocking; both streams must
+     * outlive the connection.
+     */
+    bool add(int fd, ByteStream *input, bool *error = nullptr);
+
+    /*
+     * Stops watching fd and cancels its outstanding operations. The caller still owns fd and
+     * the streams; they must stay untouched until the next poll() returns.
+     */
+    void remove(int fd);
+
+    /*
+     * Sends whatever output holds, in the background. Bytes are discarded from output as the
+     * kernel accepts them; segments already queued must not be discarded by the caller while
+     * a send is in flight, appending is fine.
+     */
+    bool send(int fd, ByteStream *output, bool *error = nullptr);
+
+    /*
+     * Waits up to timeout_ms (-1 forever, 0 not at all) for events and dispatches them to the
+     * delegate. Returns the number of events handled.
+     */
+    int32_t poll(int32_t timeout_ms, bool *error = nullptr);
+
+private:
+    struct Connection;
+    struct Ring;
+
+    IoDriver(Delegate *delegate, uint32_t buffer_size, uint32_t queue_depth);
+
+    bool setup_io_uring();
+
+    bool setup_epoll();
+
+    Connection *find(int fd);
+
+    void close_connection(uint32_t id, int error);
+
+    void post_receive(Connection *connection);
+
+    void post_send(Connection *connection);
+
+    void post_poll(Connection *connection, bool writable);
+
+    // Zeroed submission entry at the ring tail, or nullptr when the ring stays full after a
+    // submit; publish it with Ring::push().
+    struct io_uring_sqe *next_sqe();
+
+    void submit(uint32_t wait_count);
+
+    void update_fixed_buffers();
+
+    int32_t poll_io_uring(int32_t timeout_ms, bool *error);
+
+    int32_t poll_epoll(int32_t timeout_ms, bool *error);
+
+    void handle_completion(uint64_t user_data, int32_t result);
+
+    Delegate *m_delegate;
+    uint32_t m_buffer_size;
+    uint32_t m_queue_depth;
+    Ring *m_ring{nullptr};
+    int m_epoll_fd{-1};
+    uint32_t m_next_id{1};
+    std::unordered_map<uint32_t, Connection *> m_connections;
+    std::unordered_map<int, uint32_t> m_ids;
+    std::vector<ProtoBuffer *> m_fixed;
+    std::vector<uint16_t> m_free_slots;
+    std::vector<uint16_t> m_dirty_slots;
+    bool m_fixed_enabled{false};
+};
+
+#endif //TKS_PROTO_BUFFER_IO_DRIVER_H
@@ -0,0 +1,109 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_JOURNAL_H
+#define TKS_PROTO_BUFFER_JOURNAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+class ProtoBuffer;
+
+/*
+ * Append-only journal of ProtoBuffer frames stored in preallocated segment files
+ * (<directory>/<16-digit sequence>.journal). A frame is
+ *
+ *   uint32 length | uint32 masked crc32c(payload) | payload | zero padding to 4 bytes
+ *
+ * where the crc is masked as in leveldb so it is never 0; an all-zero header marks the end
+ * of the written part of a segment. Appended frames are
+ * batched in a pooled buffer and written with one pwrite per batch; commit() makes every
+ * frame appended so far durable with a single fdatasync, however many threads appended.
+ * Segments roll over once the next frame would not fit. Each open() starts a new segment.
+ */
+class Journal {
+public:
+    static Journal *open(const std::string &directory, uint32_t segment_size = 64 * 1024 * 1024,
+                         bool *error = nullptr);
+
+    Journal(Journal &) = delete;
+    Journal &operator=(Journal const &) = delete;
+
+    ~Journal();
+
+    /*
+     * Queues the bytes between buffer's position and limit as one frame and returns the
+     * frame's sequence number (0 on error). The buffer itself is left untouched.
+     */
+    uint64_t append(ProtoBuffer *buffer, bool *error = nullptr);
+
+    void flush(bool *error = nullptr);
+
+    /*
+     * Makes every frame up to `sequence` durable; by default everything appended so far.
+     * Threads committing concurrently share one fdatasync.
+     */
+    void commit(uint64_t sequence = UINT64_MAX, bool *error = nullptr);
+
+    static std::vector<std::string> segments(const std::string &directory);
+
+private:
+    Journal(std::string directory, uint32_t segment_size);
+
+    bool open_segment(bool *error);
+
+    void close_segment();
+
+    bool write_locked(const uint8_t *data, uint32_t len, bool *error);
+
+    bool flush_locked(bool *error);
+
+    std::string m_directory;
+    uint32_t m_segment_size;
+    uint64_t m_segment_sequence{0};
+    int m_fd{-1};
+    uint32_t m_offset{0};
+    ProtoBuffer *m_batch{nullptr};
+    uint64_t m_appended{0};
+    uint64_t m_written{0};
+    uint64_t m_synced{0};
+    pthread_mutex_t m_mutex{};
+    pthread_mutex_t m_sync_mutex{};
+};
+
+/*
+ * Replays a journal directory. Segments are mapped read-only and each frame is returned as a
+ * view into the mapping, without copying.
+ */
+class JournalReader {
+public:
+    explicit JournalReader(const std::string &directory);
+
+    JournalReader(JournalReader &) = delete;
+    JournalReader &operator=(JournalReader const &) = delete;
+
+    ~JournalReader();
+
+    /*
+     * Returns the next frame, positioned at its payload and limited to its end, or nullptr
+     * once every segment is exhausted. The buffer is owned by the reader and stays valid
+     * until the following call. A frame with a bad checksum (torn write) ends its segment
+     * and sets error.
+     */
+    ProtoBuffer *next(bool *error = nullptr);
+
+private:
+    bool map_next_segment(bool *error);
+
+    std::vector<std::string> m_segments;
+    size_t m_segment_index{0};
+    ProtoBuffer *m_map{nullptr};
+    uint32_t m_offset{0};
+};
+
+#endif //TKS_PROTO_BUFFER_JOURNAL_H
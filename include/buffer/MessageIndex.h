@@ -0,0 +1,113 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_MESSAGE_INDEX_H
+#define TKS_PROTO_BUFFER_MESSAGE_INDEX_H
+
+#include "ProtoBuffer.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Offsets of the messages in a batched container, built by one pass over the length headers:
+ *
+ *   [int32 0x1cb5c415] int32 count | count x byte array (see write_byte_array)
+ *
+ * The leading vector constructor is optional. Each entry keeps the payload offset and length
+ * and the 32-bit constructor id the payload starts with (0 for payloads shorter than 4
+ * bytes), so consumers can pick, skip or lazily decode single messages.
+ *
+ * Entries point into the scanned buffer; they are only valid while its memory is neither
+ * reused nor overwritten. Rescanning reuses the entry storage.
+ */
+class MessageIndex {
+public:
+    static const uint32_t vector_constructor = 0x1cb5c415;
+
+    struct Entry {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t constructor;
+    };
+
+    MessageIndex() = default;
+
+    /*
+     * Indexes the container at buffer's position. The position is left untouched; end() gives
+     * the offset right after the container. On malformed input the index is emptied.
+     */
+    bool scan(ProtoBuffer *buffer, bool *error = nullptr);
+
+    [[nodiscard]] uint32_t size() const;
+
+    [[nodiscard]] const Entry &entry(uint32_t index) const;
+
+    [[nodiscard]] uint32_t end() const;
+
+    /*
+     * Start of message `index` in the scanned buffer. Wrapping it in a stack
+     * ProtoBuffer(bytes(i), entry(i).length) decodes it without any allocation.
+     */
+    [[nodiscard]] uint8_t *bytes(uint32_t index) const;
+
+    /*
+     * Heap-allocated sliced view of message `index`, like read_proto_buff(false).
+     */
+    [[nodiscard]] ProtoBuffer *slice(uint32_t index) const;
+
+    /*
+     * Index of the first message at or after `from` with the given constructor, or -1.
+     */
+    [[nodiscard]] int32_t find(uint32_t constructor, uint32_t from = 0) const;
+
+    void clear();
+
+    /*
+     * Decodes every indexed message on the pool and stores the results in index order.
+     * decoder is called as `T decoder(ProtoBuffer *message, bool *error)` from several threads
+     * at once, each message wrapped in a stack-allocated sliced view of the shared buffer.
+     * Returns false, and sets error, if any message failed to decode. T can't be bool:
+     * std::vector<bool> packs several results into one word, so writing them from several
+     * threads would race; decode into uint8_t instead.
+     */
+    template<typename T, typename Decoder>
+    bool decode(ThreadPool &pool, std::vector<T> *results, Decoder decoder, bool *error = nullptr) const {
+        static_assert(!std::is_same_v<T, bool>, "std::vector<bool> results can't be written concurrently");
+        auto count = (uint32_t) m_entries.size();
+        results->clear();
+        results->resize(count);
+        std::atomic<bool> failed{false};
+        uint32_t grain = count / (pool.size() * 8);
+        pool.parallel_for(count, grain, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t a = begin; a < end && !failed.load(std::memory_order_relaxed); a++) {
+                ProtoBuffer message(m_bytes + m_entries[a].offset, m_entries[a].length);
+                bool message_error = false;
+                (*results)[a] = decoder(&message, &message_error);
+                if (message_error) {
+                    failed.store(true, std::memory_order_relaxed);
+                }
+            }
+        });
+        if (failed.load()) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("message index error: parallel decode failed");
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<Entry> m_entries;
+    uint8_t *m_bytes{nullptr};
+    uint32_t m_end{0};
+};
+
+#endif //TKS_PROTO_BUFFER_MESSAGE_INDEX_H
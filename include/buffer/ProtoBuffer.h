@@ -6,7 +6,9 @@
 #define TKS_PROTO_BUFFER_H
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include "fastlog/FastLog.h"
 
 #ifdef ANDROID
@@ -15,12 +17,17 @@
 
 #endif
 class Bytes;
+class StringInterner;
 
 class ProtoBuffer
 {
+    friend class BuffersStorage;
+
 private:
     void write_bytes_internal(uint8_t *b, uint32_t offset, uint32_t len);
 
+    const char *read_string_internal(uint32_t *length, bool *error);
+
     uint8_t *m_buffer{nullptr};
     bool m_calculate_size_only{false};
     bool m_sliced{false};
@@ -28,6 +35,11 @@ private:
     uint32_t m_limit{0};
     uint32_t m_capacity{0};
     bool m_buffer_owner{true};
+    bool m_validate_utf8{false};
+    bool m_mapped{false};
+    // Set while BuffersStorage holds a lifetime trace for this buffer, so unsampled releases
+    // don't have to look one up.
+    bool m_traced{false};
 #ifdef ANDROID
     jobject m_java_byte_buffer{nullptr};
 #endif
@@ -43,6 +55,41 @@ public:
 
     ~ProtoBuffer();
 
+    /*
+     * Protobuf wire types. fixed32 / fixed64 fields are write_int / write_long, which already
+     * use the little-endian layout protobuf expects.
+     */
+    enum class WireType : uint32_t {
+        varint = 0,
+        fixed64 = 1,
+        length_delimited = 2,
+        fixed32 = 5
+    };
+
+    enum class MapAdvice {
+        normal,
+        sequential,
+        random,
+        will_need
+    };
+
+    /*
+     * Maps a file into memory and wraps it like a sliced buffer: position 0, limit and
+     * capacity equal to the file size. Writable maps are shared, so writes reach the file
+     * (see sync()); read-only maps are mapped PROT_READ, so a write faults. With a non-zero
+     * size a writable file is created or resized to exactly that many bytes; a file created
+     * here is removed again if the map fails. Without a size the file must already exist and
+     * be non-empty, and a size on a read-only map is an error. Returns nullptr on failure.
+     * reuse() is a no-op, deleting the buffer unmaps the file.
+     */
+    static ProtoBuffer *map_file(const char *path, bool writable, uint32_t size = 0, bool *error = nullptr);
+
+    [[nodiscard]] bool mapped() const;
+
+    void advise(MapAdvice advice);
+
+    void sync(bool *error = nullptr);
+
     [[nodiscard]] uint32_t position() const;
 
     void position(uint32_t position);
@@ -69,6 +116,14 @@ public:
 
     void clear_capacity();
 
+    [[nodiscard]] bool validate_utf8() const;
+
+    /*
+     * When enabled, read_string and read_string_view reject payloads that are not well-formed
+     * UTF-8 through the usual error flag instead of returning them.
+     */
+    void validate_utf8(bool validate);
+
     uint8_t *bytes();
 
     void write_int(int32_t x, bool *error = nullptr);
@@ -98,8 +153,43 @@ public:
 
     void write_byte_array(ProtoBuffer *buff, bool *error = nullptr);
 
+    /*
+     * Bytes write_byte_array and write_string take for a payload of `length` bytes: the 1 or
+     * 4 byte length header, the payload and the padding to a multiple of 4.
+     */
+    static uint32_t byte_array_size(uint32_t length);
+
     void write_double(double d, bool *error = nullptr);
 
+    void write_int_array(const int32_t *values, uint32_t count, bool *error = nullptr);
+
+    void write_int_array_BE(const int32_t *values, uint32_t count, bool *error = nullptr);
+
+    void write_long_array(const int64_t *values, uint32_t count, bool *error = nullptr);
+
+    void write_double_array(const double *values, uint32_t count, bool *error = nullptr);
+
+    /*
+     * Compact encoding, compatible with the protobuf wire format: LEB128 varints, zigzag for
+     * signed values, field tags and unpadded length-prefixed bytes. Values below 128 take one
+     * byte instead of 4 or 8.
+     */
+    void write_varint(uint64_t x, bool *error = nullptr);
+
+    void write_zigzag(int64_t x, bool *error = nullptr);
+
+    void write_tag(uint32_t field, WireType type, bool *error = nullptr);
+
+    void write_length_delimited(const uint8_t *b, uint32_t len, bool *error = nullptr);
+
+    void write_length_delimited(const std::string &s, bool *error = nullptr);
+
+    /*
+     * Bytes write_varint takes for x; zigzag values are sized with varint_size of the
+     * encoded value, ((uint64_t) x << 1) ^ (x >> 63).
+     */
+    static uint32_t varint_size(uint64_t x);
+
     int32_t read_int(bool *error = nullptr);
     
     uint32_t read_u_int(bool *error = nullptr);
@@ -116,12 +206,57 @@ public:
 
     std::string read_string(bool *error = nullptr);
 
+    /*
+     * Same as read_string but returns a view into this buffer. The view is only valid while
+     * the underlying memory is neither reused nor overwritten.
+     */
+    std::string_view read_string_view(bool *error = nullptr);
+
+    /*
+     * Same as read_string but returns a shared immutable string from interner, or from the
+     * calling thread's StringInterner::current() when interner is nullptr, so repeated values
+     * are only allocated once. Returns nullptr on error.
+     */
+    std::shared_ptr<const std::string> read_interned_string(StringInterner *interner = nullptr, bool *error = nullptr);
+
     Bytes *read_byte_array(bool *error = nullptr);
 
     ProtoBuffer *read_proto_buff(bool copy, bool *error = nullptr);
 
     double read_double(bool *error = nullptr);
 
+    /*
+     * Varints longer than 10 bytes are malformed and set error.
+     */
+    uint64_t read_varint(bool *error = nullptr);
+
+    int64_t read_zigzag(bool *error = nullptr);
+
+    /*
+     * Reads a field tag and returns its field number. Field 0 and the group / reserved wire
+     * types set error.
+     */
+    uint32_t read_tag(WireType *type, bool *error = nullptr);
+
+    /*
+     * View of a length-prefixed payload in this buffer, valid while the memory is neither
+     * reused nor overwritten.
+     */
+    std::string_view read_length_delimited(bool *error = nullptr);
+
+    /*
+     * Skips the value of a field whose tag was just read.
+     */
+    void skip_field(WireType type, bool *error = nullptr);
+
+    void read_int_array(int32_t *values, uint32_t count, bool *error = nullptr);
+
+    void read_int_array_BE(int32_t *values, uint32_t count, bool *error = nullptr);
+
+    void read_long_array(int64_t *values, uint32_t count, bool *error = nullptr);
+
+    void read_double_array(double *values, uint32_t count, bool *error = nullptr);
+
     void reuse();
 
 #ifdef ANDROID
@@ -0,0 +1,116 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_RESPONSE_CACHE_H
+#define TKS_PROTO_BUFFER_RESPONSE_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <pthread.h>
+#include <unordered_map>
+
+class ByteStream;
+class ProtoBuffer;
+
+/*
+ * Finished serialized responses, kept in the pooled buffers they were encoded into and handed
+ * out as shared read-only entries, so a hot response costs one lookup and an append instead
+ * of an encode:
+ *
+ *   if (!cache.append_to(key, stream)) {
+ *       ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(size);
+ *       ... encode, flip ...
+ *       stream->append_shared(cache.put(key, buffer));
+ *   }
+ *
+ * Keys are either the caller's own 64-bit keys or content hashes (put(buffer) and
+ * content_key()); both live in the same key space. An entry is the bytes between the
+ * buffer's position and limit when it was put.
+ *
+ * Cached bytes are charged by buffer capacity, the pool memory actually held, and the least
+ * recently used entries are evicted once the total exceeds max_bytes. An evicted entry that
+ * is still queued on a ByteStream stays alive until the stream releases it; the buffer goes
+ * back to BuffersStorage with the last reference. Thread safe.
+ */
+class ResponseCache {
+public:
+    typedef std::shared_ptr<const ProtoBuffer> Entry;
+
+    explicit ResponseCache(uint64_t max_bytes = 16 * 1024 * 1024);
+
+    ~ResponseCache();
+
+    ResponseCache(const ResponseCache &) = delete;
+    ResponseCache &operator=(const ResponseCache &) = delete;
+
+    /*
+     * XXH64 of the remaining bytes of buffer.
+     */
+    static uint64_t content_key(ProtoBuffer *buffer);
+
+    Entry find(uint64_t key);
+
+    /*
+     * Appends the cached entry for key to stream without copying. Returns false on a miss.
+     */
+    bool append_to(uint64_t key, ByteStream *stream);
+
+    /*
+     * Takes ownership of a flipped pooled buffer and caches it under key, replacing any
+     * previous entry. Returns the entry, or nullptr for a null buffer. A buffer larger than
+     * max_bytes is returned as an entry without being cached.
+     */
+    Entry put(uint64_t key, ProtoBuffer *buffer);
+
+    /*
+     * Content-addressed put: when identical bytes are already cached, buffer goes back to the
+     * pool and the existing entry is returned. key, when given, receives the content key.
+     * When different bytes are cached under the same XXH64, the existing entry is kept and
+     * buffer is returned as an entry without being cached; key is then left untouched.
+     */
+    Entry put(ProtoBuffer *buffer, uint64_t *key = nullptr);
+
+    void remove(uint64_t key);
+
+    void clear();
+
+    [[nodiscard]] uint32_t size();
+
+    /*
+     * Buffer capacity currently charged to the cache.
+     */
+    [[nodiscard]] uint64_t bytes();
+
+    [[nodiscard]] uint64_t max_bytes() const;
+
+    [[nodiscard]] uint64_t hits();
+
+    [[nodiscard]] uint64_t misses();
+
+private:
+    struct Item {
+        uint64_t key;
+        uint64_t cost;
+        Entry entry;
+    };
+
+    static Entry make_entry(ProtoBuffer *buffer);
+
+    Entry insert_locked(uint64_t key, ProtoBuffer *buffer);
+
+    void erase_locked(std::list<Item>::iterator item);
+
+    std::list<Item> m_lru;
+    std::unordered_map<uint64_t, std::list<Item>::iterator> m_items;
+    uint64_t m_max_bytes;
+    uint64_t m_bytes{0};
+    uint64_t m_hits{0};
+    uint64_t m_misses{0};
+    pthread_mutex_t m_mutex{};
+};
+
+#endif //TKS_PROTO_BUFFER_RESPONSE_CACHE_H
@@ -0,0 +1,487 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_SERIALIZE_H
+#define TKS_PROTO_BUFFER_SERIALIZE_H
+
+#include "ProtoBuffer.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Field-list serialization for plain structs, using the TL encodings ProtoBuffer already
+ * writes:
+ *
+ *   struct Ping {
+ *       int64_t id;
+ *       int32_t seq;
+ *       std::string text;
+ *       BUFFER_FIELDS(id, seq, text)
+ *   };
+ *
+ * gives Ping serialize(buffer, error), deserialize(buffer, error) and size(), the exact
+ * encoded size. Fields are encoded in the listed order:
+ *
+ *   int32_t, uint32_t             int32
+ *   int64_t, uint64_t, double     int64
+ *   bool                          Bool (boolTrue / boolFalse constructor)
+ *   std::string, vector<uint8_t>  byte array, padded to 4 bytes
+ *   std::vector<T>                int32 0x1cb5c415, int32 count, the items
+ *   a struct with BUFFER_FIELDS   its fields, bare
+ *
+ * Consecutive fixed-size fields, nested all-fixed structs included, are packed into one stack
+ * array and copied with a single write_bytes / read_bytes instead of a bounds-checked call
+ * per field; vectors of fixed-size items are copied the same way in blocks. For structs whose
+ * fields are all fixed-size, serialized_fixed_size<T>() is the size as a compile-time constant.
+ */
+#define BUFFER_FIELDS(...) \
+    auto buffer_fields() { \
+        return std::tie(__VA_ARGS__); \
+    } \
+    auto buffer_fields() const { \
+        return std::tie(__VA_ARGS__); \
+    } \
+    void serialize(ProtoBuffer *buffer, bool *error = nullptr) const { \
+        serialize_fields(*this, buffer, error); \
+    } \
+    bool deserialize(ProtoBuffer *buffer, bool *error = nullptr) { \
+        return deserialize_fields(*this, buffer, error); \
+    } \
+    [[nodiscard]] uint32_t size() const { \
+        return serialized_size(*this); \
+    }
+
+/*
+ * Encoding of one field type. Fixed-size codecs provide pack/unpack on raw bytes, the others
+ * size/write/read on a buffer. Unsupported types fail to compile here.
+ */
+template<typename T, typename = void>
+struct FieldCodec;
+
+template<typename T>
+using field_type_t = std::remove_cv_t<std::remove_reference_t<T>>;
+
+template<typename Tuple, size_t I>
+using field_at_t = field_type_t<std::tuple_element_t<I, Tuple>>;
+
+template<typename T>
+using fields_tuple_t = decltype(std::declval<const T &>().buffer_fields());
+
+inline void field_pack_32(uint8_t *out, uint32_t x) {
+    out[0] = (uint8_t) x;
+    out[1] = (uint8_t) (x >> 8);
+    out[2] = (uint8_t) (x >> 16);
+    out[3] = (uint8_t) (x >> 24);
+}
+
+inline uint32_t field_unpack_32(const uint8_t *in) {
+    return (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+inline void field_pack_64(uint8_t *out, uint64_t x) {
+    field_pack_32(out, (uint32_t) x);
+    field_pack_32(out + 4, (uint32_t) (x >> 32));
+}
+
+inline uint64_t field_unpack_64(const uint8_t *in) {
+    return (uint64_t) field_unpack_32(in) | ((uint64_t) field_unpack_32(in + 4) << 32);
+}
+
+template<typename T>
+struct FieldCodec<T, std::enable_if_t<std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>>> {
+    static constexpr bool fixed = true;
+    static constexpr uint32_t fixed_size = 4;
+
+    static void pack(const T &value, uint8_t *out) {
+        field_pack_32(out, (uint32_t) value);
+    }
+
+    static bool unpack(T &value, const uint8_t *in) {
+        value = (T) field_unpack_32(in);
+        return true;
+    }
+};
+
+template<typename T>
+struct FieldCodec<T, std::enable_if_t<std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t>>> {
+    static constexpr bool fixed = true;
+    static constexpr uint32_t fixed_size = 8;
+
+    static void pack(const T &value, uint8_t *out) {
+        field_pack_64(out, (uint64_t) value);
+    }
+
+    static bool unpack(T &value, const uint8_t *in) {
+        value = (T) field_unpack_64(in);
+        return true;
+    }
+};
+
+template<>
+struct FieldCodec<double> {
+    static constexpr bool fixed = true;
+    static constexpr uint32_t fixed_size = 8;
+
+    static void pack(const double &value, uint8_t *out) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        field_pack_64(out, bits);
+    }
+
+    static bool unpack(double &value, const uint8_t *in) {
+        uint64_t bits = field_unpack_64(in);
+        memcpy(&value, &bits, sizeof(bits));
+        return true;
+    }
+};
+
+template<>
+struct FieldCodec<bool> {
+    static constexpr bool fixed = true;
+    static constexpr uint32_t fixed_size = 4;
+    static const uint32_t bool_true = 0x997275b5;
+    static const uint32_t bool_false = 0xbc799737;
+
+    static void pack(const bool &value, uint8_t *out) {
+        field_pack_32(out, value ? bool_true : bool_false);
+    }
+
+    static bool unpack(bool &value, const uint8_t *in) {
+        uint32_t constructor = field_unpack_32(in);
+        value = constructor == bool_true;
+        return constructor == bool_true || constructor == bool_false;
+    }
+};
+
+template<>
+struct FieldCodec<std::string> {
+    static constexpr bool fixed = false;
+    static constexpr uint32_t min_size = 4;
+
+    static uint32_t size(const std::string &value) {
+        return ProtoBuffer::byte_array_size((uint32_t) value.size());
+    }
+
+    static void write(const std::string &value, ProtoBuffer *buffer, bool *error) {
+        buffer->write_string(value, error);
+    }
+
+    static bool read(std::string &value, ProtoBuffer *buffer, bool * /*error*/) {
+        bool failed = false;
+        value = buffer->read_string(&failed);
+        return !failed;
+    }
+};
+
+template<>
+struct FieldCodec<std::vector<uint8_t>> {
+    static constexpr bool fixed = false;
+    static constexpr uint32_t min_size = 4;
+
+    static uint32_t size(const std::vector<uint8_t> &value) {
+        return ProtoBuffer::byte_array_size((uint32_t) value.size());
+    }
+
+    static void write(const std::vector<uint8_t> &value, ProtoBuffer *buffer, bool *error) {
+        buffer->write_byte_array((uint8_t *) value.data(), (uint32_t) value.size(), error);
+    }
+
+    static bool read(std::vector<uint8_t> &value, ProtoBuffer *buffer, bool * /*error*/) {
+        bool failed = false;
+        bool validate = buffer->validate_utf8();
+        buffer->validate_utf8(false);
+        std::string_view bytes = buffer->read_string_view(&failed);
+        buffer->validate_utf8(validate);
+        value.assign((const uint8_t *) bytes.data(), (const uint8_t *) bytes.data() + bytes.size());
+        return !failed;
+    }
+};
+
+/*
+ * Fewest bytes any encoding of T takes: fixed_size, or min_size for variable-size codecs.
+ */
+template<typename T>
+constexpr uint32_t field_min_size() {
+    if constexpr (FieldCodec<T>::fixed) {
+        return FieldCodec<T>::fixed_size;
+    } else {
+        return FieldCodec<T>::min_size;
+    }
+}
+
+template<typename T>
+struct FieldCodec<std::vector<T>, std::enable_if_t<!std::is_same_v<T, uint8_t>>> {
+    static constexpr bool fixed = false;
+    static constexpr uint32_t min_size = 8;
+    static const uint32_t vector_constructor = 0x1cb5c415;
+    static const uint32_t staging_size = 512;
+
+    static uint32_t size(const std::vector<T> &value) {
+        if constexpr (FieldCodec<T>::fixed) {
+            return 8 + (uint32_t) value.size() * FieldCodec<T>::fixed_size;
+        } else {
+            uint32_t size = 8;
+            for (const T &item : value) {
+                size += FieldCodec<T>::size(item);
+            }
+            return size;
+        }
+    }
+
+    static void write(const std::vector<T> &value, ProtoBuffer *buffer, bool *error) {
+        buffer->write_int(vector_constructor, error);
+        buffer->write_int((uint32_t) value.size(), error);
+        if constexpr (FieldCodec<T>::fixed) {
+            constexpr uint32_t item_size = FieldCodec<T>::fixed_size;
+            constexpr uint32_t per_block = item_size == 0 || item_size > staging_size ? 1 : staging_size / item_size;
+            uint8_t staging[per_block * item_size + 1];
+            auto count = (uint32_t) value.size();
+            for (uint32_t a = 0; a < count; a += per_block) {
+                uint32_t block = count - a < per_block ? count - a : per_block;
+                for (uint32_t b = 0; b < block; b++) {
+                    FieldCodec<T>::pack(value[a + b], staging + b * item_size);
+                }
+                buffer->write_bytes(staging, block * item_size, error);
+            }
+        } else {
+            for (const T &item : value) {
+                FieldCodec<T>::write(item, buffer, error);
+            }
+        }
+    }
+
+    static bool read(std::vector<T> &value, ProtoBuffer *buffer, bool *error) {
+        bool failed = false;
+        uint32_t constructor = buffer->read_u_int(&failed);
+        uint32_t count = buffer->read_u_int(&failed);
+        // Every item takes at least field_min_size bytes, so a forged count can't make the
+        // reserve / resize below allocate more than a small multiple of the input.
+        constexpr uint32_t item_min_size = field_min_size<T>();
+        if (failed || constructor != vector_constructor || count > buffer->remaining() ||
+            (uint64_t) count * item_min_size > buffer->remaining()) {
+            return false;
+        }
+        value.clear();
+        if constexpr (FieldCodec<T>::fixed) {
+            constexpr uint32_t item_size = FieldCodec<T>::fixed_size;
+            constexpr uint32_t per_block = item_size == 0 || item_size > staging_size ? 1 : staging_size / item_size;
+            value.resize(count);
+            uint8_t staging[per_block * item_size + 1];
+            for (uint32_t a = 0; a < count; a += per_block) {
+                uint32_t block = count - a < per_block ? count - a : per_block;
+                buffer->read_bytes(staging, block * item_size, &failed);
+                for (uint32_t b = 0; b < block && !failed; b++) {
+                    failed = !FieldCodec<T>::unpack(value[a + b], staging + b * item_size);
+                }
+                if (failed) {
+                    return false;
+                }
+            }
+        } else {
+            value.reserve(count);
+            for (uint32_t a = 0; a < count; a++) {
+                value.emplace_back();
+                if (!FieldCodec<T>::read(value.back(), buffer, error)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+/*
+ * Index right after the run of fixed-size fields starting at I.
+ */
+template<typename Tuple, size_t I>
+constexpr size_t fields_run_end() {
+    if constexpr (I < std::tuple_size_v<Tuple>) {
+        if constexpr (FieldCodec<field_at_t<Tuple, I>>::fixed) {
+            return fields_run_end<Tuple, I + 1>();
+        } else {
+            return I;
+        }
+    } else {
+        return I;
+    }
+}
+
+template<typename Tuple, size_t I, size_t End>
+constexpr uint32_t fields_run_size() {
+    if constexpr (I < End) {
+        return FieldCodec<field_at_t<Tuple, I>>::fixed_size + fields_run_size<Tuple, I + 1, End>();
+    } else {
+        return 0;
+    }
+}
+
+template<typename Tuple, size_t I>
+constexpr uint32_t fields_min_size() {
+    if constexpr (I < std::tuple_size_v<Tuple>) {
+        return field_min_size<field_at_t<Tuple, I>>() + fields_min_size<Tuple, I + 1>();
+    } else {
+        return 0;
+    }
+}
+
+template<size_t I, size_t End, typename Tuple>
+void fields_pack(const Tuple &fields, uint8_t *out) {
+    if constexpr (I < End) {
+        using Codec = FieldCodec<field_at_t<Tuple, I>>;
+        Codec::pack(std::get<I>(fields), out);
+        fields_pack<I + 1, End>(fields, out + Codec::fixed_size);
+    }
+}
+
+template<size_t I, size_t End, typename Tuple>
+bool fields_unpack(const Tuple &fields, const uint8_t *in) {
+    if constexpr (I < End) {
+        using Codec = FieldCodec<field_at_t<Tuple, I>>;
+        if (!Codec::unpack(std::get<I>(fields), in)) {
+            return false;
+        }
+        return fields_unpack<I + 1, End>(fields, in + Codec::fixed_size);
+    } else {
+        return true;
+    }
+}
+
+template<size_t I, typename Tuple>
+uint32_t fields_size(const Tuple &fields) {
+    if constexpr (I < std::tuple_size_v<Tuple>) {
+        using Codec = FieldCodec<field_at_t<Tuple, I>>;
+        if constexpr (Codec::fixed) {
+            constexpr size_t end = fields_run_end<Tuple, I>();
+            return fields_run_size<Tuple, I, end>() + fields_size<end>(fields);
+        } else {
+            return Codec::size(std::get<I>(fields)) + fields_size<I + 1>(fields);
+        }
+    } else {
+        return 0;
+    }
+}
+
+template<size_t I, typename Tuple>
+void fields_write(const Tuple &fields, ProtoBuffer *buffer, bool *error) {
+    if constexpr (I < std::tuple_size_v<Tuple>) {
+        using Codec = FieldCodec<field_at_t<Tuple, I>>;
+        if constexpr (Codec::fixed) {
+            constexpr size_t end = fields_run_end<Tuple, I>();
+            constexpr uint32_t length = fields_run_size<Tuple, I, end>();
+            if constexpr (length != 0) {
+                uint8_t staging[length];
+                fields_pack<I, end>(fields, staging);
+                buffer->write_bytes(staging, length, error);
+            }
+            fields_write<end>(fields, buffer, error);
+        } else {
+            Codec::write(std::get<I>(fields), buffer, error);
+            fields_write<I + 1>(fields, buffer, error);
+        }
+    }
+}
+
+template<size_t I, typename Tuple>
+bool fields_read(const Tuple &fields, ProtoBuffer *buffer, bool *error) {
+    if constexpr (I < std::tuple_size_v<Tuple>) {
+        using Codec = FieldCodec<field_at_t<Tuple, I>>;
+        if constexpr (Codec::fixed) {
+            constexpr size_t end = fields_run_end<Tuple, I>();
+            constexpr uint32_t length = fields_run_size<Tuple, I, end>();
+            if constexpr (length != 0) {
+                uint8_t staging[length];
+                bool failed = false;
+                buffer->read_bytes(staging, length, &failed);
+                if (failed || !fields_unpack<I, end>(fields, staging)) {
+                    return false;
+                }
+            }
+            return fields_read<end>(fields, buffer, error);
+        } else {
+            if (!Codec::read(std::get<I>(fields), buffer, error)) {
+                return false;
+            }
+            return fields_read<I + 1>(fields, buffer, error);
+        }
+    } else {
+        return true;
+    }
+}
+
+template<typename T>
+struct FieldCodec<T, std::void_t<fields_tuple_t<T>>> {
+    typedef fields_tuple_t<T> Fields;
+    static constexpr bool fixed = fields_run_end<Fields, 0>() == std::tuple_size_v<Fields>;
+    static constexpr uint32_t fixed_size = fields_run_size<Fields, 0, fields_run_end<Fields, 0>()>();
+    static constexpr uint32_t min_size = fields_min_size<Fields, 0>();
+
+    static void pack(const T &value, uint8_t *out) {
+        fields_pack<0, std::tuple_size_v<Fields>>(value.buffer_fields(), out);
+    }
+
+    static bool unpack(T &value, const uint8_t *in) {
+        return fields_unpack<0, std::tuple_size_v<Fields>>(value.buffer_fields(), in);
+    }
+
+    static uint32_t size(const T &value) {
+        return fields_size<0>(value.buffer_fields());
+    }
+
+    static void write(const T &value, ProtoBuffer *buffer, bool *error) {
+        fields_write<0>(value.buffer_fields(), buffer, error);
+    }
+
+    static bool read(T &value, ProtoBuffer *buffer, bool *error) {
+        return fields_read<0>(value.buffer_fields(), buffer, error);
+    }
+};
+
+/*
+ * Encoded size of T when every field is fixed-size; does not compile otherwise.
+ */
+template<typename T>
+constexpr uint32_t serialized_fixed_size() {
+    static_assert(FieldCodec<T>::fixed, "type has variable-size fields");
+    return FieldCodec<T>::fixed_size;
+}
+
+template<typename T>
+uint32_t serialized_size(const T &value) {
+    if constexpr (FieldCodec<T>::fixed) {
+        return FieldCodec<T>::fixed_size;
+    } else {
+        return FieldCodec<T>::size(value);
+    }
+}
+
+template<typename T>
+void serialize_fields(const T &value, ProtoBuffer *buffer, bool *error = nullptr) {
+    fields_write<0>(value.buffer_fields(), buffer, error);
+}
+
+/*
+ * Reads the fields in order, stopping at the first malformed or truncated one. Fields after
+ * it keep their previous values.
+ */
+template<typename T>
+bool deserialize_fields(T &value, ProtoBuffer *buffer, bool *error = nullptr) {
+    if (!fields_read<0>(value.buffer_fields(), buffer, error)) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("deserialize error: malformed or truncated fields");
+        return false;
+    }
+    return true;
+}
+
+#endif //TKS_PROTO_BUFFER_SERIALIZE_H
@@ -0,0 +1,76 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_SHARED_RING_H
+#define TKS_PROTO_BUFFER_SHARED_RING_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ProtoBuffer;
+
+/*
+ * Single-producer single-consumer ring of fixed-size slots in a memfd shared between
+ * processes. One process create()s the ring and passes fd() to the other (fork, SCM_RIGHTS),
+ * which attach()es to it. Slots are handed out as ProtoBuffer views over the shared memory,
+ * so messages are written and read in place with the normal API: no copy and, while both
+ * sides keep up, no syscall. A futex on the ring indices is only touched when a side is
+ * about to sleep in wait_readable() / wait_writable().
+ */
+class SharedRing {
+public:
+    static SharedRing *create(uint32_t slot_size, uint32_t slot_count, bool *error = nullptr);
+
+    static SharedRing *attach(int fd, bool *error = nullptr);
+
+    SharedRing(SharedRing &) = delete;
+    SharedRing &operator=(SharedRing const &) = delete;
+
+    ~SharedRing();
+
+    [[nodiscard]] int fd() const;
+
+    [[nodiscard]] uint32_t slot_size() const;
+
+    [[nodiscard]] uint32_t slot_count() const;
+
+    /*
+     * Producer side. Returns the next free slot cleared for writing, or nullptr when the ring
+     * is full. commit_write() publishes the bytes written so far (up to position()).
+     */
+    ProtoBuffer *begin_write();
+
+    void commit_write();
+
+    bool wait_writable(int32_t timeout_ms);
+
+    /*
+     * Consumer side. Returns the oldest published slot positioned at 0 and limited to its
+     * length, or nullptr when the ring is empty. commit_read() hands the slot back.
+     */
+    ProtoBuffer *begin_read();
+
+    void commit_read();
+
+    bool wait_readable(int32_t timeout_ms);
+
+private:
+    struct Header;
+
+    SharedRing(int fd, uint8_t *memory, size_t size, uint32_t slot_size, uint32_t slot_count, uint32_t stride);
+
+    int m_fd;
+    uint8_t *m_memory;
+    size_t m_size;
+    Header *m_header;
+    uint32_t m_slot_size;
+    uint32_t m_slot_count;
+    uint32_t m_stride;
+    std::vector<std::unique_ptr<ProtoBuffer>> m_slots;
+};
+
+#endif //TKS_PROTO_BUFFER_SHARED_RING_H
@@ -0,0 +1,84 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_STRING_INTERNER_H
+#define TKS_PROTO_BUFFER_STRING_INTERNER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Bounded table of immutable strings, so decoded streams that repeat the same short values
+ * (language codes, MIME types, usernames) share one allocation per distinct value instead of
+ * building a std::string per occurrence.
+ *
+ * The table is set-associative: the XXH64 of the bytes picks a set of 4 slots, a hit is a
+ * hash and length compare plus a memcmp, and a miss replaces the least recently used slot of
+ * the set. Memory is therefore bounded by capacity * max_length whatever the input; strings
+ * longer than max_length are returned as fresh handles without being stored.
+ *
+ * Handles stay valid after eviction or clear(); only the table's reference goes away. An
+ * interner is not thread safe: attach one to a decode session, or use current(), which is
+ * per thread. Handles themselves can be shared across threads.
+ */
+class StringInterner {
+public:
+    typedef std::shared_ptr<const std::string> Handle;
+
+    static const uint32_t ways = 4;
+
+    /*
+     * capacity is rounded up to a multiple of 4 slots, in a power of two number of sets.
+     */
+    explicit StringInterner(uint32_t capacity = 4096, uint32_t max_length = 64);
+
+    StringInterner(const StringInterner &) = delete;
+    StringInterner &operator=(const StringInterner &) = delete;
+
+    /*
+     * The calling thread's interner, created on first use with the default bounds.
+     */
+    static StringInterner &current();
+
+    Handle intern(const char *data, uint32_t length);
+
+    Handle intern(std::string_view value);
+
+    [[nodiscard]] uint32_t capacity() const;
+
+    [[nodiscard]] uint32_t max_length() const;
+
+    /*
+     * Strings currently held by the table.
+     */
+    [[nodiscard]] uint32_t size() const;
+
+    [[nodiscard]] uint64_t hits() const;
+
+    [[nodiscard]] uint64_t misses() const;
+
+    void clear();
+
+private:
+    struct Slot {
+        uint64_t hash;
+        uint32_t last_used;
+        Handle value;
+    };
+
+    std::vector<Slot> m_slots;
+    uint32_t m_set_mask{0};
+    uint32_t m_max_length{0};
+    uint32_t m_size{0};
+    uint32_t m_clock{0};
+    uint64_t m_hits{0};
+    uint64_t m_misses{0};
+};
+
+#endif //TKS_PROTO_BUFFER_STRING_INTERNER_H
@@ -0,0 +1,86 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_THREAD_POOL_H
+#define TKS_PROTO_BUFFER_THREAD_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <pthread.h>
+#include <vector>
+
+/*
+ * Fixed set of worker threads running parallel_for ranges. Each worker owns a deque of
+ * ranges: it takes work from the front of its own deque and, once that is empty, steals
+ * from the back of the others, so uneven ranges still keep every core busy. The calling
+ * thread takes part in the work too; a pool with no workers runs everything inline.
+ */
+class ThreadPool {
+public:
+    /*
+     * threads counts the calling thread; 0 means one per hardware thread.
+     */
+    explicit ThreadPool(uint32_t threads = 0);
+
+    ThreadPool(ThreadPool &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    ~ThreadPool();
+
+    static ThreadPool &get();
+
+    /*
+     * Number of threads running work, including the caller.
+     */
+    [[nodiscard]] uint32_t size() const;
+
+    /*
+     * Calls body(begin, end) over [0, count) in ranges of at most grain items and returns once
+     * every range has run. body runs concurrently and must be thread safe.
+     */
+    void parallel_for(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)> &body);
+
+private:
+    struct Job {
+        const std::function<void(uint32_t, uint32_t)> *body;
+        std::atomic<uint32_t> remaining;
+        pthread_mutex_t mutex;
+        pthread_cond_t done;
+    };
+
+    struct Task {
+        Job *job;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    struct Worker {
+        ThreadPool *pool{nullptr};
+        uint32_t index{0};
+        pthread_t thread{};
+        pthread_mutex_t mutex{};
+        std::deque<Task> tasks;
+    };
+
+    static void *run(void *arg);
+
+    /*
+     * self is the worker index, or the worker count for the calling thread, which only steals.
+     */
+    bool take(uint32_t self, Task *task);
+
+    static void execute(Task &task);
+
+    std::vector<Worker *> m_workers;
+    std::atomic<uint32_t> m_queued{0};
+    bool m_stop{false};
+    pthread_mutex_t m_mutex{};
+    pthread_cond_t m_wake{};
+};
+
+#endif //TKS_PROTO_BUFFER_THREAD_POOL_H
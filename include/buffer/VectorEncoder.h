@@ -0,0 +1,147 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_VECTOR_ENCODER_H
+#define TKS_PROTO_BUFFER_VECTOR_ENCODER_H
+
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "ProtoBuffer.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+static const uint32_t vector_encoder_chunk_size = 160000;
+static const uint32_t vector_encoder_sample_count = 16;
+
+/*
+ * Serializes items[0..count) as a TL vector (int32 0x1cb5c415, int32 count, the items) and
+ * appends it to out. Ranges of items are encoded on the pool, each into its own pooled
+ * buffers, and the buffers are appended in item order, so no single buffer ever has to hold
+ * the whole vector and no calculate-size pass over the items is needed.
+ *
+ * Ranges are sized by bytes: the first few items are sized to estimate the item size, each
+ * range then holds most of one 160000-byte chunk worth of items (more on large vectors, so every
+ * thread gets several ranges), and a range expected to need less takes a buffer from the
+ * smallest size class that fits. Small items therefore fill a few chunks instead of leaving one
+ * nearly empty chunk per range.
+ *
+ * encoder is called as `encoder(const T &item, ProtoBuffer *buffer, bool *error)` from several
+ * threads at once. A write that does not fit sets error like any other write; the item is
+ * then rewritten at the start of a fresh buffer. Only an item that alone exceeds the range's
+ * buffer is sized with a calculate-size pass and gets a dedicated buffer.
+ *
+ * On error nothing is appended to out and every buffer goes back to the pool.
+ */
+template<typename T, typename Encoder>
+bool encode_vector(ThreadPool &pool, const T *items, uint32_t count, Encoder encoder, ByteStream *out,
+                   bool *error = nullptr) {
+    uint32_t sample = count < vector_encoder_sample_count ? count : vector_encoder_sample_count;
+    ProtoBuffer sample_sizer(true);
+    for (uint32_t a = 0; a < sample; a++) {
+        bool sample_error = false;
+        encoder(items[a], &sample_sizer, &sample_error);
+    }
+    uint32_t item_size = sample != 0 ? sample_sizer.capacity() / sample : 0;
+    if (item_size == 0) {
+        item_size = 1;
+    }
+    // Aim ranges at 7/8 of a chunk, so a range whose items run a little over the estimate
+    // still fits and doesn't spill into a second, nearly empty chunk.
+    uint32_t grain = vector_encoder_chunk_size / 8 * 7 / item_size;
+    if (grain < count / (pool.size() * 8)) {
+        grain = count / (pool.size() * 8);
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    uint64_t range_bytes = (uint64_t) (grain < count ? grain : count) * item_size + item_size;
+    auto chunk_size = (uint32_t) (range_bytes < vector_encoder_chunk_size ? range_bytes : vector_encoder_chunk_size);
+    uint32_t ranges = count / grain + (count % grain != 0 ? 1 : 0);
+    std::vector<std::vector<ProtoBuffer *>> chunks(ranges);
+    std::atomic<bool> failed{false};
+
+    auto next_chunk = [chunk_size]() {
+        ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(chunk_size);
+        buffer->limit(buffer->capacity());
+        return buffer;
+    };
+
+    pool.parallel_for(count, grain, [&](uint32_t begin, uint32_t end) {
+        std::vector<ProtoBuffer *> &buffers = chunks[begin / grain];
+        ProtoBuffer *buffer = next_chunk();
+        for (uint32_t a = begin; a < end && !failed.load(std::memory_order_relaxed); a++) {
+            uint32_t start = buffer->position();
+            bool item_error = false;
+            encoder(items[a], buffer, &item_error);
+            if (!item_error) {
+                continue;
+            }
+            buffer->position(start);
+            if (start != 0) {
+                buffer->flip();
+                buffers.push_back(buffer);
+                buffer = next_chunk();
+                item_error = false;
+                encoder(items[a], buffer, &item_error);
+                if (!item_error) {
+                    continue;
+                }
+                buffer->position(0);
+            }
+            ProtoBuffer sizer(true);
+            item_error = false;
+            encoder(items[a], &sizer, &item_error);
+            if (item_error || sizer.capacity() <= buffer->capacity()) {
+                failed.store(true, std::memory_order_relaxed);
+                break;
+            }
+            ProtoBuffer *large = BuffersStorage::get().get_free_buffer(sizer.capacity());
+            encoder(items[a], large, &item_error);
+            if (item_error) {
+                large->reuse();
+                failed.store(true, std::memory_order_relaxed);
+                break;
+            }
+            large->flip();
+            buffers.push_back(large);
+        }
+        if (buffer->position() != 0) {
+            buffer->flip();
+            buffers.push_back(buffer);
+        } else {
+            buffer->reuse();
+        }
+    });
+
+    if (failed.load()) {
+        for (std::vector<ProtoBuffer *> &buffers : chunks) {
+            for (ProtoBuffer *buffer : buffers) {
+                buffer->reuse();
+            }
+        }
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("encode vector error: item could not be serialized");
+        return false;
+    }
+
+    ProtoBuffer *header = BuffersStorage::get().get_free_buffer(8);
+    header->write_int((uint32_t) 0x1cb5c415);
+    header->write_int(count);
+    header->flip();
+    out->append(header);
+    for (std::vector<ProtoBuffer *> &buffers : chunks) {
+        for (ProtoBuffer *buffer : buffers) {
+            out->append(buffer);
+        }
+    }
+    return true;
+}
+
+#endif //TKS_PROTO_BUFFER_VECTOR_ENCODER_H
@@ -5,12 +5,18 @@
  */
 
 #include "BuffersStorage.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <dlfcn.h>
+#include <map>
 
 BuffersStorage::BuffersStorage(bool thread_safe) : m_is_thread_safe(thread_safe)
 {
     if (thread_safe) {
         pthread_mutex_init(&m_mutex, nullptr);
     }
+    pthread_mutex_init(&m_trace_mutex, nullptr);
 
     for (uint32_t a = 0; a < 4; a++)
     {
@@ -22,7 +28,13 @@ BuffersStorage::BuffersStorage(bool thread_safe) : m_is_thread_safe(thread_safe)
     }
 }
 
-ProtoBuffer *BuffersStorage::get_free_buffer(uint32_t size)
+static uint64_t trace_now_ns()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ProtoBuffer *BuffersStorage::get_free_buffer(uint32_t size, const char *tag)
 {
     uint32_t byteCount;
     std::vector<std::unique_ptr<ProtoBuffer>> *arrayToGetFrom = nullptr;
@@ -93,6 +105,16 @@ ProtoBuffer *BuffersStorage::get_free_buffer(uint32_t size)
     {
         buffer->limit(size);
         buffer->rewind();
+        uint32_t rate = m_trace_rate.load(std::memory_order_relaxed);
+        if (rate != 0)
+        {
+            static thread_local uint32_t sample_counter = 0;
+            if (++sample_counter >= rate)
+            {
+                sample_counter = 0;
+                trace_acquire(buffer, size, tag, __builtin_return_address(0));
+            }
+        }
     }
     return buffer;
 }
@@ -103,6 +125,10 @@ void BuffersStorage::reuse_free_buffer(ProtoBuffer *buffer)
     {
         return;
     }
+    if (buffer->m_traced)
+    {
+        trace_release(buffer);
+    }
     std::vector<std::unique_ptr<ProtoBuffer>> *arrayToReuse = nullptr;
     uint32_t capacity = buffer->capacity();
     uint32_t maxCount = 10;
@@ -167,3 +193,195 @@ BuffersStorage &BuffersStorage::get()
     static BuffersStorage instance{true};
     return instance;
 }
+
+void BuffersStorage::set_tracing(uint32_t sample_rate)
+{
+    m_trace_rate.store(sample_rate, std::memory_order_relaxed);
+}
+
+uint32_t BuffersStorage::tracing() const
+{
+    return m_trace_rate.load(std::memory_order_relaxed);
+}
+
+void BuffersStorage::trace_acquire(ProtoBuffer *buffer, uint32_t size, const char *tag, const void *site)
+{
+    pthread_mutex_lock(&m_trace_mutex);
+    // An existing record means the previous holder deleted the buffer instead of reusing it
+    // and the address came back; the new acquisition replaces it.
+    m_traces.insert_or_assign(buffer, Trace{tag, site, size, buffer->capacity(), trace_now_ns()});
+    pthread_mutex_unlock(&m_trace_mutex);
+    buffer->m_traced = true;
+}
+
+void BuffersStorage::trace_release(ProtoBuffer *buffer)
+{
+    buffer->m_traced = false;
+    uint64_t now = trace_now_ns();
+    pthread_mutex_lock(&m_trace_mutex);
+    auto found = m_traces.find(buffer);
+    if (found != m_traces.end())
+    {
+        const Trace &trace = found->second;
+        const void *key = trace.tag != nullptr ? (const void *) trace.tag : trace.site;
+        auto entry = m_histograms.find(key);
+        if (entry == m_histograms.end())
+        {
+            entry = m_histograms.emplace(key, TagHistogram{trace.tag, trace.site, {}}).first;
+        }
+        HoldHistogram &histogram = entry->second.histogram;
+        uint64_t held = now - trace.acquired_ns;
+        uint64_t micros = held / 1000;
+        uint32_t bucket = micros < 2 ? 0 : (uint32_t) (63 - __builtin_clzll(micros));
+        if (bucket >= HoldHistogram::bucket_count)
+        {
+            bucket = HoldHistogram::bucket_count - 1;
+        }
+        histogram.buckets[bucket]++;
+        histogram.count++;
+        histogram.total_ns += held;
+        histogram.max_ns = std::max(histogram.max_ns, held);
+        m_traces.erase(found);
+    }
+    pthread_mutex_unlock(&m_trace_mutex);
+}
+
+std::string BuffersStorage::trace_name(const char *tag, const void *site)
+{
+    if (tag != nullptr)
+    {
+        return tag;
+    }
+    // Module-relative, so the offset can be fed to addr2line -e <module> whatever the load address.
+    char name[320];
+    Dl_info info{};
+    if (dladdr(site, &info) != 0 && info.dli_fname != nullptr)
+    {
+        snprintf(name, sizeof(name), "%s+0x%zx", info.dli_fname,
+                 (size_t) ((const uint8_t *) site - (const uint8_t *) info.dli_fbase));
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "site %p", site);
+    }
+    return name;
+}
+
+std::vector<BuffersStorage::LiveBuffer> BuffersStorage::live_buffers()
+{
+    std::vector<LiveBuffer> result;
+    uint64_t now = trace_now_ns();
+    pthread_mutex_lock(&m_trace_mutex);
+    result.reserve(m_traces.size());
+    for (auto &item : m_traces)
+    {
+        const Trace &trace = item.second;
+        result.push_back(LiveBuffer{trace_name(trace.tag, trace.site), trace.size, trace.capacity,
+                                    now - trace.acquired_ns});
+    }
+    pthread_mutex_unlock(&m_trace_mutex);
+    std::sort(result.begin(), result.end(), [](const LiveBuffer &a, const LiveBuffer &b)
+    {
+        return a.age_ns > b.age_ns;
+    });
+    return result;
+}
+
+std::vector<std::pair<std::string, BuffersStorage::HoldHistogram>> BuffersStorage::hold_histograms()
+{
+    std::map<std::string, HoldHistogram> merged;
+    pthread_mutex_lock(&m_trace_mutex);
+    for (auto &item : m_histograms)
+    {
+        const HoldHistogram &source = item.second.histogram;
+        HoldHistogram &target = merged[trace_name(item.second.tag, item.second.site)];
+        target.count += source.count;
+        target.total_ns += source.total_ns;
+        target.max_ns = std::max(target.max_ns, source.max_ns);
+        for (uint32_t a = 0; a < HoldHistogram::bucket_count; a++)
+        {
+            target.buckets[a] += source.buckets[a];
+        }
+    }
+    pthread_mutex_unlock(&m_trace_mutex);
+    return {merged.begin(), merged.end()};
+}
+
+/*
+ * Upper bound, in microseconds, of the bucket holding the p-th hold time.
+ */
+static uint64_t hold_percentile_us(const BuffersStorage::HoldHistogram &histogram, double p)
+{
+    auto wanted = (uint64_t) (p * (double) histogram.count);
+    uint64_t seen = 0;
+    for (uint32_t a = 0; a < BuffersStorage::HoldHistogram::bucket_count; a++)
+    {
+        seen += histogram.buckets[a];
+        if (seen > wanted)
+        {
+            return 2ull << a;
+        }
+    }
+    return histogram.max_ns / 1000;
+}
+
+std::string BuffersStorage::tracing_report(uint32_t max_live)
+{
+    std::vector<LiveBuffer> live = live_buffers();
+    std::vector<std::pair<std::string, HoldHistogram>> histograms = hold_histograms();
+    struct LiveSummary
+    {
+        uint32_t count{0};
+        uint64_t bytes{0};
+        uint64_t oldest_ns{0};
+    };
+    std::map<std::string, LiveSummary> summaries;
+    for (const LiveBuffer &buffer : live)
+    {
+        LiveSummary &summary = summaries[buffer.tag];
+        summary.count++;
+        summary.bytes += buffer.capacity;
+        summary.oldest_ns = std::max(summary.oldest_ns, buffer.age_ns);
+    }
+
+    std::string report;
+    char line[512];
+    snprintf(line, sizeof(line), "buffers tracing, 1 in %u sampled, %zu live\n", tracing(), live.size());
+    report += line;
+    for (auto &item : summaries)
+    {
+        snprintf(line, sizeof(line), "live %-40s %8u buffers %12llu bytes  oldest %10.3f s\n", item.first.c_str(),
+                 item.second.count, (unsigned long long) item.second.bytes, (double) item.second.oldest_ns / 1e9);
+        report += line;
+    }
+    for (auto &item : histograms)
+    {
+        const HoldHistogram &histogram = item.second;
+        if (histogram.count == 0)
+        {
+            continue;
+        }
+        snprintf(line, sizeof(line),
+                 "held %-40s %8llu released  mean %10.1f us  p50 <%llu us  p99 <%llu us  max %10.1f us\n",
+                 item.first.c_str(), (unsigned long long) histogram.count,
+                 (double) histogram.total_ns / (double) histogram.count / 1000.0,
+                 (unsigned long long) hold_percentile_us(histogram, 0.5),
+                 (unsigned long long) hold_percentile_us(histogram, 0.99), (double) histogram.max_ns / 1000.0);
+        report += line;
+    }
+    for (uint32_t a = 0; a < live.size() && a < max_live; a++)
+    {
+        snprintf(line, sizeof(line), "  %-40s size %8u capacity %8u age %10.3f s\n", live[a].tag.c_str(),
+                 live[a].size, live[a].capacity, (double) live[a].age_ns / 1e9);
+        report += line;
+    }
+    return report;
+}
+
+void BuffersStorage::reset_tracing()
+{
+    pthread_mutex_lock(&m_trace_mutex);
+    m_traces.clear();
+    m_histograms.clear();
+    pthread_mutex_unlock(&m_trace_mutex);
+}
@@ -6,33 +6,127 @@
 
 #include "ByteStream.h"
 #include "ProtoBuffer.h"
+#include "Checksum.h"
+#include <cerrno>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+static const uint32_t max_iov_count = 64;
+
+uint32_t ByteStream::Segment::remaining() const {
+    return buffer != nullptr ? buffer->remaining() : length;
+}
+
+bool ByteStream::Segment::in_memory() const {
+    return buffer != nullptr || shared != nullptr;
+}
+
+uint8_t *ByteStream::Segment::data() const {
+    if (buffer != nullptr) {
+        return buffer->bytes() + buffer->position();
+    }
+    // Shared bytes are only ever read; bytes() just isn't const.
+    return const_cast<ProtoBuffer *>(shared.get())->bytes() + offset;
+}
 
 void ByteStream::append(ProtoBuffer *buffer) {
     if (buffer == nullptr) {
         return;
     }
-    m_buffers_queue.push_back(buffer);
+    Segment segment;
+    segment.buffer = buffer;
+    m_buffers_queue.push_back(segment);
+}
+
+void ByteStream::append_shared(const std::shared_ptr<const ProtoBuffer> &buffer) {
+    if (buffer == nullptr) {
+        return;
+    }
+    // The stream's position over the shared bytes lives in the segment, like a file region,
+    // so appending doesn't allocate.
+    if (!buffer->has_remaining()) {
+        return;
+    }
+    Segment segment;
+    segment.shared = buffer;
+    segment.offset = buffer->position();
+    segment.length = buffer->remaining();
+    m_buffers_queue.push_back(std::move(segment));
+}
+
+void ByteStream::append_file(int fd, uint64_t offset, uint32_t length, bool close_fd) {
+    if (fd < 0) {
+        return;
+    }
+    if (length == 0) {
+        if (close_fd) {
+            close(fd);
+        }
+        return;
+    }
+    Segment segment;
+    segment.fd = fd;
+    segment.close_fd = close_fd;
+    segment.offset = offset;
+    segment.length = length;
+    m_buffers_queue.push_back(segment);
 }
 
 bool ByteStream::has_data() {
     size_t size = m_buffers_queue.size();
     for (uint32_t a = 0; a < size; a++) {
-        if (m_buffers_queue[a]->has_remaining()) {
+        if (m_buffers_queue[a].remaining() > 0) {
             return true;
         }
     }
     return false;
 }
 
+bool ByteStream::has_data(uint32_t count) {
+    uint64_t queued = 0;
+    size_t size = m_buffers_queue.size();
+    for (uint32_t a = 0; a < size && queued < count; a++) {
+        queued += m_buffers_queue[a].remaining();
+    }
+    return queued >= count;
+}
+
 void ByteStream::get(ProtoBuffer *dst) {
     if (dst == nullptr) {
         return;
     }
 
     size_t size = m_buffers_queue.size();
-    ProtoBuffer *buffer;
     for (uint32_t a = 0; a < size; a++) {
-        buffer = m_buffers_queue[a];
+        Segment &segment = m_buffers_queue[a];
+        if (segment.shared != nullptr) {
+            uint32_t count = segment.length < dst->remaining() ? segment.length : dst->remaining();
+            dst->write_bytes(segment.data(), count);
+            if (!dst->has_remaining()) {
+                break;
+            }
+            continue;
+        }
+        if (segment.buffer == nullptr) {
+            if (!dst->has_remaining()) {
+                break;
+            }
+            uint32_t count = segment.length < dst->remaining() ? segment.length : dst->remaining();
+            ssize_t result = pread(segment.fd, dst->bytes() + dst->position(), count, (off_t) segment.offset);
+            if (result <= 0) {
+                DEBUG_E("byte stream get: can't read file segment");
+                break;
+            }
+            dst->position(dst->position() + (uint32_t) result);
+            if ((uint32_t) result < segment.length) {
+                break;
+            }
+            continue;
+        }
+        ProtoBuffer *buffer = segment.buffer;
         if (buffer->remaining() > dst->remaining()) {
             dst->write_bytes(buffer->bytes(), buffer->position(), dst->remaining());
             break;
@@ -46,18 +140,22 @@ void ByteStream::get(ProtoBuffer *dst) {
 
 void ByteStream::discard(uint32_t count) {
     uint32_t remaining;
-    ProtoBuffer *buffer;
     while (count > 0) {
         if (m_buffers_queue.empty()) {
             break;
         }
-        buffer = m_buffers_queue[0];
-        remaining = buffer->remaining();
+        Segment &segment = m_buffers_queue[0];
+        remaining = segment.remaining();
         if (count < remaining) {
-            buffer->position(buffer->position() + count);
+            if (segment.buffer != nullptr) {
+                segment.buffer->position(segment.buffer->position() + count);
+            } else {
+                segment.offset += count;
+                segment.length -= count;
+            }
             break;
         }
-        buffer->reuse();
+        release(segment);
         m_buffers_queue.erase(m_buffers_queue.begin());
         count -= remaining;
     }
@@ -69,8 +167,153 @@ void ByteStream::clean() {
     }
     size_t size = m_buffers_queue.size();
     for (uint32_t a = 0; a < size; a++) {
-        ProtoBuffer *buffer = m_buffers_queue[a];
-        buffer->reuse();
+        release(m_buffers_queue[a]);
     }
     m_buffers_queue.clear();
 }
+
+void ByteStream::release(Segment &segment) {
+    if (segment.shared != nullptr) {
+        segment.shared.reset();
+    } else if (segment.buffer != nullptr) {
+        segment.buffer->reuse();
+        segment.buffer = nullptr;
+    } else if (segment.close_fd && segment.fd >= 0) {
+        close(segment.fd);
+        segment.fd = -1;
+    }
+}
+
+uint32_t ByteStream::send_to(int fd, bool *error) {
+    uint32_t total = 0;
+    while (!m_buffers_queue.empty()) {
+        Segment &first = m_buffers_queue[0];
+        ssize_t result;
+        uint32_t wanted;
+        if (first.in_memory()) {
+            struct iovec iov[max_iov_count];
+            int count = (int) prepare_iov(iov, max_iov_count, &wanted);
+            if (count == 0) {
+                while (!m_buffers_queue.empty() && m_buffers_queue[0].in_memory() &&
+                       m_buffers_queue[0].remaining() == 0) {
+                    release(m_buffers_queue[0]);
+                    m_buffers_queue.erase(m_buffers_queue.begin());
+                }
+                continue;
+            }
+            result = writev(fd, iov, count);
+        } else {
+            wanted = first.length;
+            if (wanted == 0) {
+                release(first);
+                m_buffers_queue.erase(m_buffers_queue.begin());
+                continue;
+            }
+#ifdef __linux__
+            auto offset = (off_t) first.offset;
+            result = sendfile(fd, first.fd, &offset, wanted);
+#else
+            uint8_t chunk[16384];
+            result = pread(first.fd, chunk, wanted < sizeof(chunk) ? wanted : sizeof(chunk), (off_t) first.offset);
+            if (result > 0) {
+                result = write(fd, chunk, (size_t) result);
+            }
+#endif
+        }
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                if (error != nullptr) {
+                    *error = true;
+                }
+                DEBUG_E("byte stream send error %d", errno);
+            }
+            break;
+        }
+        if (result == 0) {
+            break;
+        }
+        discard((uint32_t) result);
+        total += (uint32_t) result;
+        if ((uint32_t) result < wanted) {
+            break;
+        }
+    }
+    return total;
+}
+
+uint32_t ByteStream::prepare_iov(struct iovec *iov, uint32_t max_count, uint32_t *total) {
+    uint32_t count = 0;
+    uint32_t bytes = 0;
+    size_t size = m_buffers_queue.size();
+    for (uint32_t a = 0; a < size && count < max_count; a++) {
+        const Segment &segment = m_buffers_queue[a];
+        if (!segment.in_memory()) {
+            break;
+        }
+        uint32_t remaining = segment.remaining();
+        if (remaining == 0) {
+            continue;
+        }
+        iov[count].iov_base = segment.data();
+        iov[count].iov_len = remaining;
+        bytes += remaining;
+        count++;
+    }
+    if (total != nullptr) {
+        *total = bytes;
+    }
+    return count;
+}
+
+void ByteStream::update_checksum(Crc32c *crc) {
+    if (crc == nullptr) {
+        return;
+    }
+    uint8_t chunk[4096];
+    size_t size = m_buffers_queue.size();
+    for (uint32_t a = 0; a < size; a++) {
+        Segment &segment = m_buffers_queue[a];
+        if (segment.in_memory()) {
+            crc->update(segment.data(), segment.remaining());
+            continue;
+        }
+        for (uint32_t done = 0; done < segment.length;) {
+            uint32_t count = segment.length - done < sizeof(chunk) ? segment.length - done : sizeof(chunk);
+            ssize_t result = pread(segment.fd, chunk, count, (off_t) (segment.offset + done));
+            if (result <= 0) {
+                DEBUG_E("byte stream checksum: can't read file segment");
+                break;
+            }
+            crc->update(chunk, (size_t) result);
+            done += (uint32_t) result;
+        }
+    }
+}
+
+void ByteStream::update_checksum(XxHash64 *hash) {
+    if (hash == nullptr) {
+        return;
+    }
+    uint8_t chunk[4096];
+    size_t size = m_buffers_queue.size();
+    for (uint32_t a = 0; a < size; a++) {
+        Segment &segment = m_buffers_queue[a];
+        if (segment.in_memory()) {
+            hash->update(segment.data(), segment.remaining());
+            continue;
+        }
+        for (uint32_t done = 0; done < segment.length;) {
+            uint32_t count = segment.length - done < sizeof(chunk) ? segment.length - done : sizeof(chunk);
+            ssize_t result = pread(segment.fd, chunk, count, (off_t) (segment.offset + done));
+            if (result <= 0) {
+                DEBUG_E("byte stream checksum: can't read file segment");
+                break;
+            }
+            hash->update(chunk, (size_t) result);
+            done += (uint32_t) result;
+        }
+    }
+}
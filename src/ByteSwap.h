@@ -0,0 +1,140 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_BYTE_SWAP_H
+#define TKS_PROTO_BUFFER_BYTE_SWAP_H
+
+#include <cstdint>
+#include <memory.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define TKS_HOST_BIG_ENDIAN 1
+#else
+#define TKS_HOST_BIG_ENDIAN 0
+#endif
+
+/*
+ * Copies `count` 32-bit / 64-bit words from src to dst reversing the byte order of each word.
+ * Neither pointer needs to be aligned; the tail that does not fill a vector is swapped scalar.
+ */
+static inline void swap_copy32(uint8_t *dst, const uint8_t *src, uint32_t count) {
+    uint32_t a = 0;
+#if defined(__AVX2__)
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; a + 8 <= count; a += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + a * 4));
+        _mm256_storeu_si256((__m256i *) (dst + a * 4), _mm256_shuffle_epi8(v, mask));
+    }
+#elif defined(__SSSE3__)
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; a + 4 <= count; a += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + a * 4));
+        _mm_storeu_si128((__m128i *) (dst + a * 4), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(__SSE2__)
+    for (; a + 4 <= count; a += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + a * 4));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i *) (dst + a * 4), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; a + 4 <= count; a += 4) {
+        vst1q_u8(dst + a * 4, vrev32q_u8(vld1q_u8(src + a * 4)));
+    }
+#endif
+    for (; a < count; a++) {
+        uint32_t v;
+        memcpy(&v, src + a * 4, 4);
+        v = __builtin_bswap32(v);
+        memcpy(dst + a * 4, &v, 4);
+    }
+}
+
+static inline void swap_copy64(uint8_t *dst, const uint8_t *src, uint32_t count) {
+    uint32_t a = 0;
+#if defined(__AVX2__)
+    const __m256i mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                          7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    for (; a + 4 <= count; a += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + a * 8));
+        _mm256_storeu_si256((__m256i *) (dst + a * 8), _mm256_shuffle_epi8(v, mask));
+    }
+#elif defined(__SSSE3__)
+    const __m128i mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    for (; a + 2 <= count; a += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + a * 8));
+        _mm_storeu_si128((__m128i *) (dst + a * 8), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(__SSE2__)
+    for (; a + 2 <= count; a += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + a * 8));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i *) (dst + a * 8), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; a + 2 <= count; a += 2) {
+        vst1q_u8(dst + a * 8, vrev64q_u8(vld1q_u8(src + a * 8)));
+    }
+#endif
+    for (; a < count; a++) {
+        uint64_t v;
+        memcpy(&v, src + a * 8, 8);
+        v = __builtin_bswap64(v);
+        memcpy(dst + a * 8, &v, 8);
+    }
+}
+
+/*
+ * Copies `count` words between host byte order and little-endian (le_) or big-endian (be_)
+ * wire order. The conversion is symmetric, so the same helper serves reads and writes. An
+ * empty copy may come with null pointers, as from an empty std::vector, and touches nothing.
+ */
+static inline void le_copy32(uint8_t *dst, const uint8_t *src, uint32_t count) {
+#if TKS_HOST_BIG_ENDIAN
+    swap_copy32(dst, src, count);
+#else
+    if (count != 0) {
+        memcpy(dst, src, (size_t) count * 4);
+    }
+#endif
+}
+
+static inline void le_copy64(uint8_t *dst, const uint8_t *src, uint32_t count) {
+#if TKS_HOST_BIG_ENDIAN
+    swap_copy64(dst, src, count);
+#else
+    if (count != 0) {
+        memcpy(dst, src, (size_t) count * 8);
+    }
+#endif
+}
+
+static inline void be_copy32(uint8_t *dst, const uint8_t *src, uint32_t count) {
+#if TKS_HOST_BIG_ENDIAN
+    if (count != 0) {
+        memcpy(dst, src, (size_t) count * 4);
+    }
+#else
+    swap_copy32(dst, src, count);
+#endif
+}
+
+#endif //TKS_PROTO_BUFFER_BYTE_SWAP_H
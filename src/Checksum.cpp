@@ -0,0 +1,333 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Checksum.h"
+#include "ProtoBuffer.h"
+#include <array>
+#include <memory.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TKS_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define TKS_CRC32C_ARM 1
+#include <arm_acle.h>
+#endif
+
+using Crc32cTable = std::array<std::array<uint32_t, 256>, 8>;
+
+static constexpr Crc32cTable make_crc32c_table() {
+    Crc32cTable table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1u)));
+        }
+        table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (size_t k = 1; k < 8; k++) {
+            table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+        }
+    }
+    return table;
+}
+
+static constexpr Crc32cTable crc32c_table = make_crc32c_table();
+
+static inline uint32_t load_le32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline uint64_t load_le64(const uint8_t *p) {
+    return (uint64_t) load_le32(p) | ((uint64_t) load_le32(p + 4) << 32);
+}
+
+static uint32_t crc32c_slicing8(uint32_t crc, const uint8_t *p, size_t len) {
+    const Crc32cTable &t = crc32c_table;
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t lo = load_le32(p) ^ crc;
+        uint32_t hi = load_le32(p + 4);
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+        len--;
+    }
+    return crc;
+}
+
+#if TKS_CRC32C_SSE42
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+        p += 8;
+        len -= 8;
+    }
+    crc = (uint32_t) crc64;
+#endif
+    while (len >= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *p++);
+        len--;
+    }
+    return crc;
+}
+
+static bool crc32c_hw_available() {
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+}
+
+#elif TKS_CRC32C_ARM
+
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+    return crc;
+}
+
+static bool crc32c_hw_available() {
+    return true;
+}
+
+#endif
+
+uint32_t Crc32c::extend(uint32_t crc, const uint8_t *data, size_t len) {
+    uint32_t l = ~crc;
+#if TKS_CRC32C_SSE42 || TKS_CRC32C_ARM
+    if (crc32c_hw_available()) {
+        return ~crc32c_hw(l, data, len);
+    }
+#endif
+    return ~crc32c_slicing8(l, data, len);
+}
+
+uint32_t Crc32c::compute(const uint8_t *data, size_t len) {
+    return extend(0, data, len);
+}
+
+void Crc32c::update(const uint8_t *data, size_t len) {
+    m_crc = extend(m_crc, data, len);
+}
+
+void Crc32c::update(ProtoBuffer *buffer, uint32_t offset, uint32_t len, bool *error) {
+    if (buffer == nullptr || buffer->bytes() == nullptr || (uint64_t) offset + len > buffer->limit()) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("crc32c update error: range %u+%u outside the buffer", offset, len);
+        return;
+    }
+    update(buffer->bytes() + offset, len);
+}
+
+void Crc32c::track(ProtoBuffer *buffer) {
+    m_tracked = buffer;
+    m_mark = buffer != nullptr ? buffer->position() : 0;
+}
+
+void Crc32c::update_written() {
+    if (m_tracked == nullptr) {
+        return;
+    }
+    uint32_t position = m_tracked->position();
+    if (position > m_mark) {
+        update(m_tracked, m_mark, position - m_mark);
+    }
+    m_mark = position;
+}
+
+uint32_t Crc32c::value() const {
+    return m_crc;
+}
+
+void Crc32c::reset() {
+    m_crc = 0;
+    m_tracked = nullptr;
+    m_mark = 0;
+}
+
+static const uint64_t PRIME64_1 = 0x9e3779b185ebca87ULL;
+static const uint64_t PRIME64_2 = 0xc2b2ae3d27d4eb4fULL;
+static const uint64_t PRIME64_3 = 0x165667b19e3779f9ULL;
+static const uint64_t PRIME64_4 = 0x85ebca77c2b2ae63ULL;
+static const uint64_t PRIME64_5 = 0x27d4eb2f165667c5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+static uint64_t xxh64_finalize(uint64_t h, const uint8_t *p, size_t len) {
+    while (len >= 8) {
+        h ^= xxh64_round(0, load_le64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        h ^= (uint64_t) load_le32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        len -= 4;
+    }
+    while (len > 0) {
+        h ^= (*p++) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        len--;
+    }
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+XxHash64::XxHash64(uint64_t seed) {
+    reset(seed);
+}
+
+uint64_t XxHash64::compute(const uint8_t *data, size_t len, uint64_t seed) {
+    XxHash64 hash(seed);
+    hash.update(data, len);
+    return hash.value();
+}
+
+void XxHash64::update(const uint8_t *data, size_t len) {
+    if (data == nullptr || len == 0) {
+        return;
+    }
+    m_total_len += len;
+    if (m_mem_size + len < 32) {
+        memcpy(m_mem + m_mem_size, data, len);
+        m_mem_size += (uint32_t) len;
+        return;
+    }
+    if (m_mem_size > 0) {
+        uint32_t fill = 32 - m_mem_size;
+        memcpy(m_mem + m_mem_size, data, fill);
+        for (int a = 0; a < 4; a++) {
+            m_acc[a] = xxh64_round(m_acc[a], load_le64(m_mem + a * 8));
+        }
+        data += fill;
+        len -= fill;
+        m_mem_size = 0;
+    }
+    uint64_t v1 = m_acc[0], v2 = m_acc[1], v3 = m_acc[2], v4 = m_acc[3];
+    while (len >= 32) {
+        v1 = xxh64_round(v1, load_le64(data));
+        v2 = xxh64_round(v2, load_le64(data + 8));
+        v3 = xxh64_round(v3, load_le64(data + 16));
+        v4 = xxh64_round(v4, load_le64(data + 24));
+        data += 32;
+        len -= 32;
+    }
+    m_acc[0] = v1;
+    m_acc[1] = v2;
+    m_acc[2] = v3;
+    m_acc[3] = v4;
+    if (len > 0) {
+        memcpy(m_mem, data, len);
+        m_mem_size = (uint32_t) len;
+    }
+}
+
+void XxHash64::update(ProtoBuffer *buffer, uint32_t offset, uint32_t len, bool *error) {
+    if (buffer == nullptr || buffer->bytes() == nullptr || (uint64_t) offset + len > buffer->limit()) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("xxhash64 update error: range %u+%u outside the buffer", offset, len);
+        return;
+    }
+    update(buffer->bytes() + offset, len);
+}
+
+void XxHash64::track(ProtoBuffer *buffer) {
+    m_tracked = buffer;
+    m_mark = buffer != nullptr ? buffer->position() : 0;
+}
+
+void XxHash64::update_written() {
+    if (m_tracked == nullptr) {
+        return;
+    }
+    uint32_t position = m_tracked->position();
+    if (position > m_mark) {
+        update(m_tracked, m_mark, position - m_mark);
+    }
+    m_mark = position;
+}
+
+uint64_t XxHash64::value() const {
+    uint64_t h;
+    if (m_total_len >= 32) {
+        h = rotl64(m_acc[0], 1) + rotl64(m_acc[1], 7) + rotl64(m_acc[2], 12) + rotl64(m_acc[3], 18);
+        for (uint64_t acc : m_acc) {
+            h = xxh64_merge_round(h, acc);
+        }
+    } else {
+        h = m_seed + PRIME64_5;
+    }
+    h += m_total_len;
+    return xxh64_finalize(h, m_mem, m_mem_size);
+}
+
+void XxHash64::reset(uint64_t seed) {
+    m_seed = seed;
+    m_acc[0] = seed + PRIME64_1 + PRIME64_2;
+    m_acc[1] = seed + PRIME64_2;
+    m_acc[2] = seed;
+    m_acc[3] = seed - PRIME64_1;
+    m_total_len = 0;
+    m_mem_size = 0;
+    m_tracked = nullptr;
+    m_mark = 0;
+}
@@ -0,0 +1,498 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Compression.h"
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "ByteSwap.h"
+#include "MemCopy.h"
+#include "ProtoBuffer.h"
+#include <cstring>
+#ifdef TKS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static const uint32_t lz4_hash_log = 12;
+static const uint32_t lz4_min_match = 4;
+static const uint32_t lz4_last_literals = 5;
+static const uint32_t lz4_match_limit = 12;
+static const uint32_t lz4_max_offset = 65535;
+static const uint32_t max_raw_length = 256 * 1024 * 1024;
+
+static inline uint32_t load32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint64_t load64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - lz4_hash_log);
+}
+
+/*
+ * Number of equal bytes at a and b, checked 8 at a time, without reading past limit on a.
+ */
+static inline uint32_t common_length(const uint8_t *a, const uint8_t *b, const uint8_t *limit) {
+    const uint8_t *start = a;
+    while (a + 8 <= limit) {
+        uint64_t diff = load64(a) ^ load64(b);
+        if (diff != 0) {
+#if TKS_HOST_BIG_ENDIAN
+            return (uint32_t) (a - start) + (uint32_t) (__builtin_clzll(diff) >> 3);
+#else
+            return (uint32_t) (a - start) + (uint32_t) (__builtin_ctzll(diff) >> 3);
+#endif
+        }
+        a += 8;
+        b += 8;
+    }
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+    return (uint32_t) (a - start);
+}
+
+static inline uint8_t *write_length(uint8_t *op, uint32_t length) {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t) length;
+    return op;
+}
+
+/*
+ * Greedy LZ4 block compression with a single-probe hash table. Returns the compressed size,
+ * or 0 when the output would not fit in capacity.
+ */
+static uint32_t lz4_compress(const uint8_t *src, uint32_t length, uint8_t *dst, uint32_t capacity,
+                             uint32_t *table, uint32_t acceleration) {
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + capacity;
+    uint32_t anchor = 0;
+    if (length >= lz4_match_limit + 1) {
+        memset(table, 0, sizeof(uint32_t) << lz4_hash_log);
+        const uint8_t *match_end = src + length - lz4_last_literals;
+        uint32_t limit = length - lz4_match_limit;
+        uint32_t ip = 1;
+        uint32_t misses = 0;
+        while (ip < limit) {
+            uint32_t sequence = load32(src + ip);
+            uint32_t hash = lz4_hash(sequence);
+            uint32_t ref = table[hash];
+            table[hash] = ip;
+            if (ip - ref > lz4_max_offset || load32(src + ref) != sequence || ref >= ip) {
+                misses++;
+                ip += 1 + (misses >> 6) * acceleration;
+                continue;
+            }
+            while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            uint32_t match_length = lz4_min_match + common_length(src + ip + lz4_min_match,
+                                                                  src + ref + lz4_min_match, match_end);
+            uint32_t literals = ip - anchor;
+            if ((size_t) (op_end - op) < 1 + literals + literals / 255 + 1 + 2 + match_length / 255 + 1) {
+                return 0;
+            }
+            uint8_t *token = op++;
+            if (literals >= 15) {
+                *token = 15 << 4;
+                op = write_length(op, literals - 15);
+            } else {
+                *token = (uint8_t) (literals << 4);
+            }
+            buffer_copy(op, src + anchor, literals);
+            op += literals;
+            uint32_t offset = ip - ref;
+            *op++ = (uint8_t) offset;
+            *op++ = (uint8_t) (offset >> 8);
+            uint32_t extra = match_length - lz4_min_match;
+            if (extra >= 15) {
+                *token |= 15;
+                op = write_length(op, extra - 15);
+            } else {
+                *token |= (uint8_t) extra;
+            }
+            ip += match_length;
+            anchor = ip;
+            misses = 0;
+            if (ip >= limit) {
+                break;
+            }
+            table[lz4_hash(load32(src + ip - 2))] = ip - 2;
+        }
+    }
+    uint32_t literals = length - anchor;
+    if ((size_t) (op_end - op) < 1 + literals + literals / 255 + 1) {
+        return 0;
+    }
+    if (literals >= 15) {
+        *op++ = 15 << 4;
+        op = write_length(op, literals - 15);
+    } else {
+        *op++ = (uint8_t) (literals << 4);
+    }
+    buffer_copy(op, src + anchor, literals);
+    op += literals;
+    return (uint32_t) (op - dst);
+}
+
+static inline bool read_length(const uint8_t *src, uint32_t src_length, uint32_t *ip, uint64_t *length) {
+    uint8_t byte;
+    do {
+        if (*ip >= src_length) {
+            return false;
+        }
+        byte = src[(*ip)++];
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/*
+ * Bounds-checked LZ4 block decoding; fails unless the block decodes to exactly dst_length bytes.
+ */
+static bool lz4_decompress(const uint8_t *src, uint32_t src_length, uint8_t *dst, uint32_t dst_length) {
+    uint32_t ip = 0;
+    uint32_t op = 0;
+    while (ip < src_length) {
+        uint8_t token = src[ip++];
+        uint64_t literals = token >> 4;
+        if (literals == 15 && !read_length(src, src_length, &ip, &literals)) {
+            return false;
+        }
+        if (literals > src_length - ip || literals > dst_length - op) {
+            return false;
+        }
+        buffer_copy(dst + op, src + ip, (size_t) literals);
+        ip += (uint32_t) literals;
+        op += (uint32_t) literals;
+        if (ip == src_length) {
+            break;
+        }
+        if (src_length - ip < 2) {
+            return false;
+        }
+        uint32_t offset = src[ip] | ((uint32_t) src[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+        uint64_t match_length = token & 15;
+        if (match_length == 15 && !read_length(src, src_length, &ip, &match_length)) {
+            return false;
+        }
+        match_length += lz4_min_match;
+        if (match_length > dst_length - op) {
+            return false;
+        }
+        uint8_t *out = dst + op;
+        const uint8_t *match = out - offset;
+        if (offset >= match_length) {
+            buffer_copy(out, match, (size_t) match_length);
+        } else {
+            for (uint64_t a = 0; a < match_length; a++) {
+                out[a] = match[a];
+            }
+        }
+        op += (uint32_t) match_length;
+    }
+    return op == dst_length;
+}
+
+Compressor::Compressor(CompressionCodec codec, uint32_t threshold, int32_t level) : m_codec(codec),
+                                                                                    m_threshold(threshold),
+                                                                                    m_level(level) {
+    if (m_codec == CompressionCodec::lz4) {
+        m_table = new uint32_t[1u << lz4_hash_log];
+        if (m_level < 1) {
+            m_level = 1;
+        }
+    }
+#ifdef TKS_HAVE_ZLIB
+    // deflateInit fails on anything else, which would frame every payload as stored.
+    if (m_codec == CompressionCodec::zlib && m_level != Z_DEFAULT_COMPRESSION &&
+        (m_level < Z_NO_COMPRESSION || m_level > Z_BEST_COMPRESSION)) {
+        int32_t clamped = m_level < Z_NO_COMPRESSION ? Z_NO_COMPRESSION : Z_BEST_COMPRESSION;
+        DEBUG_W("compressor: zlib level %d out of range, using %d", m_level, clamped);
+        m_level = clamped;
+    }
+#endif
+}
+
+Compressor::~Compressor() {
+    delete[] m_table;
+    m_table = nullptr;
+#ifdef TKS_HAVE_ZLIB
+    if (m_zstream != nullptr) {
+        deflateEnd((z_stream *) m_zstream);
+        delete (z_stream *) m_zstream;
+        m_zstream = nullptr;
+    }
+#endif
+}
+
+bool Compressor::available(CompressionCodec codec) {
+    switch (codec) {
+        case CompressionCodec::stored:
+        case CompressionCodec::lz4:
+            return true;
+        case CompressionCodec::zlib:
+#ifdef TKS_HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+uint32_t Compressor::max_frame_size(uint32_t length) {
+    return header_size + length;
+}
+
+ProtoBuffer *Compressor::compress(ProtoBuffer *src, bool *error) {
+    if (src == nullptr) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("compress error: null buffer");
+        return nullptr;
+    }
+    return compress(src->bytes() + src->position(), src->remaining(), error);
+}
+
+ProtoBuffer *Compressor::compress(const uint8_t *data, uint32_t length, bool *error) {
+    // decompress() refuses frames above max_raw_length, so don't produce them.
+    if (!available(m_codec) || length > max_raw_length) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("compress error: codec %u unavailable or payload of %u bytes too large", (uint32_t) m_codec,
+                length);
+        return nullptr;
+    }
+    ProtoBuffer *frame = BuffersStorage::get().get_free_buffer(max_frame_size(length));
+    uint8_t *out = frame->bytes() + header_size;
+    uint32_t packed = 0;
+    CompressionCodec codec = m_codec;
+    if (length >= m_threshold && length > 1 && codec != CompressionCodec::stored) {
+        if (codec == CompressionCodec::lz4) {
+            packed = lz4_compress(data, length, out, length - 1, m_table, (uint32_t) m_level);
+        }
+#ifdef TKS_HAVE_ZLIB
+        else if (codec == CompressionCodec::zlib) {
+            auto *stream = (z_stream *) m_zstream;
+            if (stream == nullptr) {
+                stream = new z_stream();
+                if (deflateInit(stream, m_level) != Z_OK) {
+                    delete stream;
+                    stream = nullptr;
+                }
+                m_zstream = stream;
+            } else {
+                deflateReset(stream);
+            }
+            if (stream != nullptr) {
+                stream->next_in = (Bytef *) data;
+                stream->avail_in = length;
+                stream->next_out = out;
+                stream->avail_out = length - 1;
+                if (deflate(stream, Z_FINISH) == Z_STREAM_END) {
+                    packed = (uint32_t) stream->total_out;
+                }
+            }
+        }
+#endif
+    }
+    if (packed == 0) {
+        codec = CompressionCodec::stored;
+        buffer_copy(out, data, length);
+        packed = length;
+    }
+    frame->position(0);
+    frame->limit(header_size + packed);
+    frame->write_int((uint32_t) codec);
+    frame->write_int((uint32_t) length);
+    frame->write_int((uint32_t) packed);
+    frame->position(0);
+    return frame;
+}
+
+uint32_t Compressor::compress(ByteStream *src, ByteStream *dst, bool *error) {
+    if (src == nullptr || dst == nullptr) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("compress error: null stream");
+        return 0;
+    }
+    uint32_t consumed = 0;
+    ProtoBuffer *block = BuffersStorage::get().get_free_buffer(stream_block_size);
+    while (true) {
+        block->clear();
+        block->limit(stream_block_size);
+        src->get(block);
+        uint32_t count = block->position();
+        if (count == 0) {
+            break;
+        }
+        block->flip();
+        bool frame_error = false;
+        ProtoBuffer *frame = compress(block, &frame_error);
+        if (frame_error) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            break;
+        }
+        dst->append(frame);
+        src->discard(count);
+        consumed += count;
+    }
+    block->reuse();
+    return consumed;
+}
+
+/*
+ * Validates the frame header at data and returns the packed length, or sets error.
+ */
+static bool parse_header(const uint8_t *data, CompressionCodec *codec, uint32_t *raw_length, uint32_t *packed_length) {
+    uint32_t header[3];
+    le_copy32((uint8_t *) header, data, 3);
+    *codec = (CompressionCodec) header[0];
+    *raw_length = header[1];
+    *packed_length = header[2];
+    if (!Compressor::available(*codec) || *raw_length > max_raw_length || *packed_length > max_raw_length) {
+        DEBUG_E("decompress error: bad frame header (codec %u, raw %u, packed %u)", header[0], header[1],
+                header[2]);
+        return false;
+    }
+    if (*codec == CompressionCodec::stored && *packed_length != *raw_length) {
+        DEBUG_E("decompress error: stored frame length mismatch");
+        return false;
+    }
+    return true;
+}
+
+static bool decode(CompressionCodec codec, const uint8_t *packed, uint32_t packed_length, uint8_t *out,
+                   uint32_t raw_length) {
+    switch (codec) {
+        case CompressionCodec::stored:
+            buffer_copy(out, packed, raw_length);
+            return true;
+        case CompressionCodec::lz4:
+            return lz4_decompress(packed, packed_length, out, raw_length);
+        case CompressionCodec::zlib: {
+#ifdef TKS_HAVE_ZLIB
+            uLongf out_length = raw_length;
+            return uncompress(out, &out_length, packed, packed_length) == Z_OK && out_length == raw_length;
+#else
+            return false;
+#endif
+        }
+    }
+    return false;
+}
+
+ProtoBuffer *Compressor::decompress(ProtoBuffer *src, bool *error) {
+    if (src == nullptr || src->remaining() < header_size) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("decompress error: truncated frame header");
+        return nullptr;
+    }
+    CompressionCodec codec;
+    uint32_t raw_length;
+    uint32_t packed_length;
+    const uint8_t *data = src->bytes() + src->position();
+    if (!parse_header(data, &codec, &raw_length, &packed_length) ||
+        packed_length > src->remaining() - header_size) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("decompress error: bad or truncated frame");
+        return nullptr;
+    }
+    ProtoBuffer *result = BuffersStorage::get().get_free_buffer(raw_length);
+    if (!decode(codec, data + header_size, packed_length, result->bytes(), raw_length)) {
+        result->reuse();
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("decompress error: corrupted payload");
+        return nullptr;
+    }
+    result->position(0);
+    result->limit(raw_length);
+    src->position(src->position() + header_size + packed_length);
+    return result;
+}
+
+uint32_t Compressor::decompress(ByteStream *src, ByteStream *dst, bool *error) {
+    if (src == nullptr || dst == nullptr) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("decompress error: null stream");
+        return 0;
+    }
+    uint32_t produced = 0;
+    ProtoBuffer *header = BuffersStorage::get().get_free_buffer(header_size);
+    while (true) {
+        header->clear();
+        header->limit(header_size);
+        src->get(header);
+        if (header->position() < header_size) {
+            break;
+        }
+        CompressionCodec codec;
+        uint32_t raw_length;
+        uint32_t packed_length;
+        if (!parse_header(header->bytes(), &codec, &raw_length, &packed_length)) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            break;
+        }
+        // The frame stays queued in src until all of it has arrived: nothing is allocated or
+        // copied for a partial frame, however large its header says it is.
+        if (!src->has_data(header_size + packed_length)) {
+            break;
+        }
+        ProtoBuffer *frame = BuffersStorage::get().get_free_buffer(header_size + packed_length);
+        src->get(frame);
+        if (frame->has_remaining()) {
+            frame->reuse();
+            break;
+        }
+        frame->position(0);
+        bool frame_error = false;
+        ProtoBuffer *payload = decompress(frame, &frame_error);
+        frame->reuse();
+        if (frame_error) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            break;
+        }
+        dst->append(payload);
+        src->discard(header_size + packed_length);
+        produced += raw_length;
+    }
+    header->reuse();
+    return produced;
+}
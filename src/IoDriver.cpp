@@ -0,0 +1,861 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "IoDriver.h"
+#include "BuffersStorage.h"
+#include "ByteStream.h"
+#include "ProtoBuffer.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define TKS_HAVE_IO_URING 1
+#endif
+#endif
+
+static const uint32_t max_send_iov = 64;
+static const uint16_t no_slot = 0xffff;
+
+enum IoOperation : uint64_t {
+    io_receive = 1,
+    io_send = 2,
+    io_timeout = 3,
+    io_cancel = 4,
+    io_receive_poll = 5,
+    io_send_poll = 6
+};
+
+// Completions the destructor waits for while cancelling in-flight operations, 10ms each.
+static const int32_t drain_attempts = 100;
+
+static inline uint64_t make_user_data(IoOperation operation, uint16_t slot, uint32_t id) {
+    return ((uint64_t) operation << 56) | ((uint64_t) slot << 32) | id;
+}
+
+struct IoDriver::Connection {
+    uint32_t id{0};
+    int fd{-1};
+    ByteStream *input{nullptr};
+    ByteStream *output{nullptr};
+    bool removed{false};
+    bool receive_pending{false};
+    bool send_pending{false};
+    bool receive_polling{false};
+    bool send_polling{false};
+    uint16_t receive_slot{no_slot};
+    ProtoBuffer *receive_buffer{nullptr};
+    struct iovec send_iov[max_send_iov]{};
+    struct msghdr send_message{};
+};
+
+#ifdef TKS_HAVE_IO_URING
+
+struct IoDriver::Ring {
+    int fd{-1};
+    uint32_t entries{0};
+    void *sq_map{nullptr};
+    size_t sq_map_size{0};
+    void *cq_map{nullptr};
+    size_t cq_map_size{0};
+    struct io_uring_sqe *sqes{nullptr};
+    size_t sqes_size{0};
+    std::atomic<uint32_t> *sq_head{nullptr};
+    std::atomic<uint32_t> *sq_tail{nullptr};
+    uint32_t sq_mask{0};
+    uint32_t *sq_array{nullptr};
+    std::atomic<uint32_t> *cq_head{nullptr};
+    std::atomic<uint32_t> *cq_tail{nullptr};
+    uint32_t cq_mask{0};
+    struct io_uring_cqe *cqes{nullptr};
+    uint32_t to_submit{0};
+    std::vector<struct iovec> fixed_iov;
+
+    ~Ring() {
+        if (sqes != nullptr) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_map != nullptr && cq_map != sq_map) {
+            munmap(cq_map, cq_map_size);
+        }
+        if (sq_map != nullptr) {
+            munmap(sq_map, sq_map_size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // Publishes the entry next_sqe() handed out.
+    void push() {
+        uint32_t tail = sq_tail->load(std::memory_order_relaxed);
+        uint32_t index = tail & sq_mask;
+        sq_array[index] = index;
+        sq_tail->store(tail + 1, std::memory_order_release);
+        to_submit++;
+    }
+
+    int enter(uint32_t submit, uint32_t wait, uint32_t flags) const {
+        return (int) syscall(__NR_io_uring_enter, fd, submit, wait, flags, nullptr, 0);
+    }
+};
+
+#else
+
+struct IoDriver::Ring {
+};
+
+#endif
+
+IoDriver::IoDriver(Delegate *delegate, uint32_t buffer_size, uint32_t queue_depth) : m_delegate(delegate),
+                                                                                     m_buffer_size(buffer_size),
+                                                                                     m_queue_depth(queue_depth) {
+}
+
+IoDriver *IoDriver::create(Delegate *delegate, uint32_t buffer_size, uint32_t queue_depth, bool use_io_uring,
+                           bool *error) {
+    if (delegate == nullptr || buffer_size == 0 || queue_depth == 0 || queue_depth >= no_slot) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("io driver error: bad parameters");
+        return nullptr;
+    }
+    auto *driver = new IoDriver(delegate, buffer_size, queue_depth);
+    if (use_io_uring && driver->setup_io_uring()) {
+        return driver;
+    }
+    if (driver->setup_epoll()) {
+        return driver;
+    }
+    delete driver;
+    if (error != nullptr) {
+        *error = true;
+    }
+    DEBUG_E("io driver error: neither io_uring nor epoll available");
+    return nullptr;
+}
+
+IoDriver::~IoDriver() {
+    // The kernel may still write into receive buffers and read send iovecs until their
+    // operations complete, so cancel them and wait before anything is handed back to the pool.
+    bool drained = true;
+    if (m_ring != nullptr) {
+        std::vector<int> fds;
+        fds.reserve(m_ids.size());
+        for (auto &item : m_ids) {
+            fds.push_back(item.first);
+        }
+        for (int fd : fds) {
+            remove(fd);
+        }
+        for (int32_t a = 0; a < drain_attempts && !m_connections.empty(); a++) {
+            poll_io_uring(10, nullptr);
+        }
+        drained = m_connections.empty();
+        if (!drained) {
+            DEBUG_E("io driver error: %u connection(s) still in flight, leaking their buffers",
+                    (uint32_t) m_connections.size());
+        }
+    }
+    if (drained) {
+        for (auto &item : m_connections) {
+            if (item.second->receive_buffer != nullptr && item.second->receive_slot == no_slot) {
+                item.second->receive_buffer->reuse();
+            }
+            delete item.second;
+        }
+    }
+    m_connections.clear();
+    delete m_ring;
+    m_ring = nullptr;
+    for (ProtoBuffer *buffer : m_fixed) {
+        if (drained) {
+            buffer->reuse();
+        }
+    }
+    m_fixed.clear();
+    if (m_epoll_fd >= 0) {
+        close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
+}
+
+bool IoDriver::uses_io_uring() const {
+    return m_ring != nullptr;
+}
+
+bool IoDriver::setup_io_uring() {
+#ifdef TKS_HAVE_IO_URING
+    struct io_uring_params params{};
+    uint32_t entries = 1;
+    while (entries < m_queue_depth * 2 + 2) {
+        entries <<= 1;
+    }
+    int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        DEBUG_D("io_uring unavailable (%d), using epoll", errno);
+        return false;
+    }
+    auto *ring = new Ring();
+    ring->fd = fd;
+    ring->entries = params.sq_entries;
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_map && ring->cq_map_size > ring->sq_map_size) {
+        ring->sq_map_size = ring->cq_map_size;
+    }
+    ring->sq_map = mmap(nullptr, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = nullptr;
+        delete ring;
+        return false;
+    }
+    if (single_map) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(nullptr, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                            IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = nullptr;
+            delete ring;
+            return false;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *) mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = nullptr;
+        delete ring;
+        return false;
+    }
+    auto *sq = (uint8_t *) ring->sq_map;
+    auto *cq = (uint8_t *) ring->cq_map;
+    ring->sq_head = (std::atomic<uint32_t> *) (sq + params.sq_off.head);
+    ring->sq_tail = (std::atomic<uint32_t> *) (sq + params.sq_off.tail);
+    ring->sq_mask = *(uint32_t *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t *) (sq + params.sq_off.array);
+    ring->cq_head = (std::atomic<uint32_t> *) (cq + params.cq_off.head);
+    ring->cq_tail = (std::atomic<uint32_t> *) (cq + params.cq_off.tail);
+    ring->cq_mask = *(uint32_t *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    m_ring = ring;
+
+    std::vector<struct iovec> &iov = ring->fixed_iov;
+    iov.resize(m_queue_depth);
+    for (uint32_t a = 0; a < m_queue_depth; a++) {
+        ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(m_buffer_size, "IoDriver fixed buffer");
+        m_fixed.push_back(buffer);
+        iov[a].iov_base = buffer->bytes();
+        iov[a].iov_len = buffer->capacity();
+    }
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov.data(), m_queue_depth) == 0) {
+        struct io_uring_rsrc_update2 update{};
+        update.offset = 0;
+        update.data = (uint64_t) (uintptr_t) iov.data();
+        update.nr = 1;
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) >= 0) {
+            m_fixed_enabled = true;
+        } else {
+            syscall(__NR_io_uring_register, fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        }
+    }
+    if (m_fixed_enabled) {
+        for (uint32_t a = m_queue_depth; a > 0; a--) {
+            m_free_slots.push_back((uint16_t) (a - 1));
+        }
+    } else {
+        DEBUG_D("io_uring fixed buffers unavailable, receiving into plain pooled buffers");
+        for (ProtoBuffer *buffer : m_fixed) {
+            buffer->reuse();
+        }
+        m_fixed.clear();
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IoDriver::setup_epoll() {
+#ifdef __linux__
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    return m_epoll_fd >= 0;
+#else
+    return false;
+#endif
+}
+
+IoDriver::Connection *IoDriver::find(int fd) {
+    auto id = m_ids.find(fd);
+    if (id == m_ids.end()) {
+        return nullptr;
+    }
+    return m_connections[id->second];
+}
+
+bool IoDriver::add(int fd, ByteStream *input, bool *error) {
+    if (fd < 0 || input == nullptr || find(fd) != nullptr) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("io driver error: can't add fd %d", fd);
+        return false;
+    }
+    auto *connection = new Connection();
+    connection->id = m_next_id++;
+    if (m_next_id == 0) {
+        m_next_id = 1;
+    }
+    connection->fd = fd;
+    connection->input = input;
+    if (m_ring == nullptr) {
+#ifdef __linux__
+        struct epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u32 = connection->id;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            delete connection;
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("io driver error: epoll_ctl add %d", errno);
+            return false;
+        }
+#endif
+    }
+    m_connections[connection->id] = connection;
+    m_ids[fd] = connection->id;
+    if (m_ring != nullptr) {
+        post_receive(connection);
+        if (find(fd) == nullptr) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+void IoDriver::remove(int fd) {
+    auto id = m_ids.find(fd);
+    if (id == m_ids.end()) {
+        return;
+    }
+    Connection *connection = m_connections[id->second];
+    m_ids.erase(id);
+    connection->removed = true;
+#ifdef TKS_HAVE_IO_URING
+    if (m_ring != nullptr) {
+        for (IoOperation operation : {io_receive, io_send}) {
+            bool pending = operation == io_receive ? connection->receive_pending : connection->send_pending;
+            if (!pending) {
+                continue;
+            }
+            uint64_t target;
+            if (operation == io_receive) {
+                target = connection->receive_polling ? make_user_data(io_receive_poll, no_slot, connection->id)
+                                                     : make_user_data(io_receive, connection->receive_slot,
+                                                                      connection->id);
+            } else {
+                target = make_user_data(connection->send_polling ? io_send_poll : io_send, no_slot,
+                                        connection->id);
+            }
+            struct io_uring_sqe *sqe = next_sqe();
+            if (sqe == nullptr) {
+                // The operation stays pending and frees the connection when it completes.
+                continue;
+            }
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = target;
+            sqe->user_data = make_user_data(io_cancel, no_slot, connection->id);
+            m_ring->push();
+        }
+        if (connection->receive_pending || connection->send_pending) {
+            return;
+        }
+    }
+#endif
+#ifdef __linux__
+    if (m_ring == nullptr) {
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+#endif
+    m_connections.erase(connection->id);
+    delete connection;
+}
+
+void IoDriver::close_connection(uint32_t id, int error) {
+    auto item = m_connections.find(id);
+    if (item == m_connections.end()) {
+        return;
+    }
+    Connection *connection = item->second;
+    int fd = connection->fd;
+    bool notify = !connection->removed;
+    remove(fd);
+    if (notify) {
+        m_delegate->on_connection_closed(fd, error);
+    }
+}
+
+bool IoDriver::send(int fd, ByteStream *output, bool *error) {
+    Connection *connection = find(fd);
+    if (connection == nullptr || output == nullptr) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("io driver error: send to unknown fd %d", fd);
+        return false;
+    }
+    connection->output = output;
+    if (m_ring != nullptr) {
+        if (!connection->send_pending) {
+            post_send(connection);
+        }
+        return true;
+    }
+#ifdef __linux__
+    bool send_error = false;
+    uint32_t sent = output->send_to(fd, &send_error);
+    if (send_error) {
+        close_connection(connection->id, errno != 0 ? errno : EIO);
+        return false;
+    }
+    if (sent > 0) {
+        m_delegate->on_data_sent(fd, sent);
+    }
+    struct epoll_event event{};
+    event.events = EPOLLIN | EPOLLRDHUP | (output->has_data() ? (uint32_t) EPOLLOUT : 0);
+    event.data.u32 = connection->id;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+#endif
+    return true;
+}
+
+void IoDriver::post_receive(Connection *connection) {
+#ifdef TKS_HAVE_IO_URING
+    struct io_uring_sqe *sqe = next_sqe();
+    if (sqe == nullptr) {
+        close_connection(connection->id, EBUSY);
+        return;
+    }
+    uint16_t slot = no_slot;
+    if (m_fixed_enabled && !m_free_slots.empty()) {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+        connection->receive_buffer = m_fixed[slot];
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->buf_index = slot;
+        sqe->off = (uint64_t) -1;
+    } else {
+        connection->receive_buffer = BuffersStorage::get().get_free_buffer(m_buffer_size, "IoDriver receive");
+        sqe->opcode = IORING_OP_RECV;
+    }
+    connection->receive_slot = slot;
+    connection->receive_buffer->clear();
+    sqe->fd = connection->fd;
+    sqe->addr = (uint64_t) (uintptr_t) connection->receive_buffer->bytes();
+    sqe->len = connection->receive_buffer->capacity();
+    sqe->user_data = make_user_data(io_receive, slot, connection->id);
+    m_ring->push();
+    connection->receive_pending = true;
+#else
+    (void) connection;
+#endif
+}
+
+void IoDriver::post_send(Connection *connection) {
+#ifdef TKS_HAVE_IO_URING
+    ByteStream *output = connection->output;
+    if (output == nullptr || !output->has_data()) {
+        return;
+    }
+    uint32_t count = output->prepare_iov(connection->send_iov, max_send_iov);
+    if (count == 0) {
+        bool send_error = false;
+        uint32_t sent = output->send_to(connection->fd, &send_error);
+        if (send_error) {
+            close_connection(connection->id, errno != 0 ? errno : EIO);
+            return;
+        }
+        if (sent > 0) {
+            m_delegate->on_data_sent(connection->fd, sent);
+        }
+        count = output->prepare_iov(connection->send_iov, max_send_iov);
+        if (count == 0) {
+            return;
+        }
+    }
+    struct io_uring_sqe *sqe = next_sqe();
+    if (sqe == nullptr) {
+        close_connection(connection->id, EBUSY);
+        return;
+    }
+    memset(&connection->send_message, 0, sizeof(connection->send_message));
+    connection->send_message.msg_iov = connection->send_iov;
+    connection->send_message.msg_iovlen = count;
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = connection->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &connection->send_message;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = make_user_data(io_send, no_slot, connection->id);
+    m_ring->push();
+    connection->send_pending = true;
+#else
+    (void) connection;
+#endif
+}
+
+void IoDriver::post_poll(Connection *connection, bool writable) {
+#ifdef TKS_HAVE_IO_URING
+    struct io_uring_sqe *sqe = next_sqe();
+    if (sqe == nullptr) {
+        close_connection(connection->id, EBUSY);
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = connection->fd;
+    sqe->poll32_events = writable ? POLLOUT : POLLIN | POLLRDHUP;
+    sqe->user_data = make_user_data(writable ? io_send_poll : io_receive_poll, no_slot, connection->id);
+    m_ring->push();
+    if (writable) {
+        connection->send_pending = true;
+        connection->send_polling = true;
+    } else {
+        connection->receive_pending = true;
+        connection->receive_polling = true;
+    }
+#else
+    (void) connection;
+    (void) writable;
+#endif
+}
+
+void IoDriver::update_fixed_buffers() {
+#ifdef TKS_HAVE_IO_URING
+    if (m_dirty_slots.empty()) {
+        return;
+    }
+    uint16_t first = no_slot;
+    uint16_t last = 0;
+    for (uint16_t slot : m_dirty_slots) {
+        first = slot < first ? slot : first;
+        last = slot > last ? slot : last;
+    }
+    // fixed_iov holds one entry per slot, so the dirty range is updated in place.
+    struct iovec *iov = m_ring->fixed_iov.data();
+    for (uint16_t a = first; a <= last; a++) {
+        iov[a].iov_base = m_fixed[a]->bytes();
+        iov[a].iov_len = m_fixed[a]->capacity();
+    }
+    struct io_uring_rsrc_update2 update{};
+    update.offset = first;
+    update.data = (uint64_t) (uintptr_t) (iov + first);
+    update.nr = (uint32_t) (last - first + 1);
+    if (syscall(__NR_io_uring_register, m_ring->fd, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) < 0) {
+        DEBUG_E("io driver error: can't update fixed buffers %d", errno);
+    }
+    m_dirty_slots.clear();
+#endif
+}
+
+struct io_uring_sqe *IoDriver::next_sqe() {
+#ifdef TKS_HAVE_IO_URING
+    Ring *ring = m_ring;
+    uint32_t tail = ring->sq_tail->load(std::memory_order_relaxed);
+    if (tail - ring->sq_head->load(std::memory_order_acquire) >= ring->entries) {
+        submit(0);
+        // submit() can fail without the kernel consuming anything; writing anyway would
+        // overwrite an entry that was never submitted.
+        if (tail - ring->sq_head->load(std::memory_order_acquire) >= ring->entries) {
+            DEBUG_E("io driver error: submission queue full");
+            return nullptr;
+        }
+    }
+    struct io_uring_sqe *sqe = &ring->sqes[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+#else
+    return nullptr;
+#endif
+}
+
+void IoDriver::submit(uint32_t wait_count) {
+#ifdef TKS_HAVE_IO_URING
+    update_fixed_buffers();
+    uint32_t to_submit = m_ring->to_submit;
+    while (true) {
+        int result = m_ring->enter(to_submit, wait_count, wait_count > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (result >= 0) {
+            m_ring->to_submit -= (uint32_t) result <= to_submit ? (uint32_t) result : to_submit;
+            break;
+        }
+        if (errno != EINTR) {
+            DEBUG_E("io driver error: io_uring_enter %d", errno);
+            break;
+        }
+        if (wait_count > 0) {
+            break;
+        }
+    }
+#else
+    (void) wait_count;
+#endif
+}
+
+void IoDriver::handle_completion(uint64_t user_data, int32_t result) {
+    auto operation = (IoOperation) (user_data >> 56);
+    auto slot = (uint16_t) ((user_data >> 32) & 0xffff);
+    auto id = (uint32_t) user_data;
+    if (operation == io_timeout || operation == io_cancel) {
+        return;
+    }
+    auto item = m_connections.find(id);
+    if (item == m_connections.end()) {
+        return;
+    }
+    Connection *connection = item->second;
+    if (operation == io_receive_poll || operation == io_send_poll) {
+        bool writable = operation == io_send_poll;
+        if (writable) {
+            connection->send_pending = false;
+            connection->send_polling = false;
+        } else {
+            connection->receive_pending = false;
+            connection->receive_polling = false;
+        }
+        if (connection->removed) {
+            if (!connection->receive_pending && !connection->send_pending) {
+                m_connections.erase(id);
+                delete connection;
+            }
+            return;
+        }
+        if (result < 0 && result != -EINTR) {
+            close_connection(id, -result);
+        } else if (writable) {
+            post_send(connection);
+        } else {
+            post_receive(connection);
+        }
+        return;
+    }
+    if (operation == io_receive) {
+        connection->receive_pending = false;
+        ProtoBuffer *buffer = connection->receive_buffer;
+        connection->receive_buffer = nullptr;
+        bool handed_out = false;
+        if (result > 0 && !connection->removed) {
+            buffer->position(0);
+            buffer->limit((uint32_t) result);
+            connection->input->append(buffer);
+            handed_out = true;
+        }
+        if (slot != no_slot) {
+            if (handed_out) {
+                m_fixed[slot] = BuffersStorage::get().get_free_buffer(m_buffer_size, "IoDriver fixed buffer");
+                m_dirty_slots.push_back(slot);
+            }
+            m_free_slots.push_back(slot);
+        } else if (!handed_out) {
+            buffer->reuse();
+        }
+        if (connection->removed) {
+            if (!connection->send_pending) {
+                m_connections.erase(id);
+                delete connection;
+            }
+            return;
+        }
+        if (result > 0) {
+            m_delegate->on_data_received(connection->fd, connection->input, (uint32_t) result);
+            auto again = m_connections.find(id);
+            if (again != m_connections.end() && !again->second->removed) {
+                post_receive(again->second);
+            }
+        } else if (result == -EINTR) {
+            post_receive(connection);
+        } else if (result == -EAGAIN || result == -ENOBUFS) {
+            // Connections are non-blocking, so re-posting straight away would spin until data
+            // arrives; wait for readability without holding a buffer instead.
+            post_poll(connection, false);
+        } else {
+            close_connection(id, result == 0 ? 0 : -result);
+        }
+        return;
+    }
+    if (operation == io_send) {
+        connection->send_pending = false;
+        if (connection->removed) {
+            if (!connection->receive_pending) {
+                m_connections.erase(id);
+                delete connection;
+            }
+            return;
+        }
+        if (result > 0) {
+            connection->output->discard((uint32_t) result);
+            m_delegate->on_data_sent(connection->fd, (uint32_t) result);
+            auto again = m_connections.find(id);
+            if (again != m_connections.end() && !again->second->removed) {
+                post_send(again->second);
+            }
+        } else if (result == -EINTR || result == 0) {
+            post_send(connection);
+        } else if (result == -EAGAIN) {
+            post_poll(connection, true);
+        } else {
+            close_connection(id, -result);
+        }
+    }
+}
+
+int32_t IoDriver::poll_io_uring(int32_t timeout_ms, bool *error) {
+#ifdef TKS_HAVE_IO_URING
+    Ring *ring = m_ring;
+    struct __kernel_timespec timeout{};
+    uint32_t wait_count = 0;
+    uint32_t head = ring->cq_head->load(std::memory_order_relaxed);
+    if (ring->cq_tail->load(std::memory_order_acquire) == head && timeout_ms != 0) {
+        wait_count = 1;
+        if (timeout_ms > 0) {
+            timeout.tv_sec = timeout_ms / 1000;
+            timeout.tv_nsec = (long long) (timeout_ms % 1000) * 1000000LL;
+            struct io_uring_sqe *sqe = next_sqe();
+            if (sqe == nullptr) {
+                // Waiting without the timeout could block forever.
+                wait_count = 0;
+            } else {
+                sqe->opcode = IORING_OP_TIMEOUT;
+                sqe->fd = -1;
+                sqe->addr = (uint64_t) (uintptr_t) &timeout;
+                sqe->len = 1;
+                sqe->off = 1;
+                sqe->user_data = make_user_data(io_timeout, no_slot, 0);
+                m_ring->push();
+            }
+        }
+    }
+    if (ring->to_submit > 0 || wait_count > 0) {
+        submit(wait_count);
+    }
+    int32_t handled = 0;
+    while (true) {
+        head = ring->cq_head->load(std::memory_order_relaxed);
+        uint32_t tail = ring->cq_tail->load(std::memory_order_acquire);
+        if (head == tail) {
+            break;
+        }
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+            uint64_t user_data = cqe->user_data;
+            int32_t result = cqe->res;
+            head++;
+            ring->cq_head->store(head, std::memory_order_release);
+            if ((IoOperation) (user_data >> 56) != io_timeout && (IoOperation) (user_data >> 56) != io_cancel) {
+                handled++;
+            }
+            handle_completion(user_data, result);
+        }
+    }
+    if (ring->to_submit > 0) {
+        submit(0);
+    }
+    (void) error;
+    return handled;
+#else
+    (void) timeout_ms;
+    (void) error;
+    return 0;
+#endif
+}
+
+int32_t IoDriver::poll_epoll(int32_t timeout_ms, bool *error) {
+#ifdef __linux__
+    struct epoll_event events[64];
+    int count = epoll_wait(m_epoll_fd, events, 64, timeout_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("io driver error: epoll_wait %d", errno);
+        }
+        return 0;
+    }
+    for (int a = 0; a < count; a++) {
+        uint32_t id = events[a].data.u32;
+        auto item = m_connections.find(id);
+        if (item == m_connections.end()) {
+            continue;
+        }
+        Connection *connection = item->second;
+        if ((events[a].events & EPOLLOUT) != 0 && connection->output != nullptr) {
+            send(connection->fd, connection->output, nullptr);
+            if (m_connections.find(id) == m_connections.end()) {
+                continue;
+            }
+        }
+        if ((events[a].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) == 0) {
+            continue;
+        }
+        while (true) {
+            ProtoBuffer *buffer = BuffersStorage::get().get_free_buffer(m_buffer_size, "IoDriver receive");
+            buffer->clear();
+            // The delegate may consume the input and hand the buffer back to the pool, so
+            // nothing reads it after the callback.
+            uint32_t capacity = buffer->capacity();
+            ssize_t result = recv(connection->fd, buffer->bytes(), capacity, 0);
+            if (result > 0) {
+                buffer->limit((uint32_t) result);
+                connection->input->append(buffer);
+                int fd = connection->fd;
+                m_delegate->on_data_received(fd, connection->input, (uint32_t) result);
+                if (m_connections.find(id) == m_connections.end() || connection->removed) {
+                    break;
+                }
+                if ((uint32_t) result < capacity) {
+                    break;
+                }
+                continue;
+            }
+            buffer->reuse();
+            if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                break;
+            }
+            close_connection(id, result == 0 ? 0 : errno);
+            break;
+        }
+    }
+    return count;
+#else
+    (void) timeout_ms;
+    (void) error;
+    return 0;
+#endif
+}
+
+int32_t IoDriver::poll(int32_t timeout_ms, bool *error) {
+    if (m_ring != nullptr) {
+        return poll_io_uring(timeout_ms, error);
+    }
+    return poll_epoll(timeout_ms, error);
+}
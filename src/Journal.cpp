@@ -0,0 +1,398 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Journal.h"
+#include "BuffersStorage.h"
+#include "Checksum.h"
+#include "ProtoBuffer.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+static const uint32_t journal_batch_size = 160000;
+static const uint32_t frame_header_size = 8;
+static const char *const journal_suffix = ".journal";
+
+static inline uint32_t mask_crc(uint32_t crc) {
+    return ((crc >> 15) | (crc << 17)) + 0xa282ead8u;
+}
+
+static inline uint32_t frame_padding(uint32_t len) {
+    return (4 - (len & 3)) & 3;
+}
+
+static bool parse_segment_sequence(const char *name, uint64_t *sequence) {
+    size_t len = strlen(name);
+    size_t suffix_len = strlen(journal_suffix);
+    if (len != 16 + suffix_len || strcmp(name + 16, journal_suffix) != 0) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (int a = 0; a < 16; a++) {
+        if (name[a] < '0' || name[a] > '9') {
+            return false;
+        }
+        value = value * 10 + (uint64_t) (name[a] - '0');
+    }
+    *sequence = value;
+    return true;
+}
+
+static bool write_fully(int fd, struct iovec *iov, int count, uint32_t offset) {
+    while (count > 0) {
+        ssize_t result = pwritev(fd, iov, count, (off_t) offset);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += (uint32_t) result;
+        while (count > 0 && (size_t) result >= iov->iov_len) {
+            result -= (ssize_t) iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *) iov->iov_base + result;
+            iov->iov_len -= (size_t) result;
+        }
+    }
+    return true;
+}
+
+Journal::Journal(std::string directory, uint32_t segment_size) : m_directory(std::move(directory)),
+                                                                 m_segment_size(segment_size) {
+    pthread_mutex_init(&m_mutex, nullptr);
+    pthread_mutex_init(&m_sync_mutex, nullptr);
+}
+
+Journal *Journal::open(const std::string &directory, uint32_t segment_size, bool *error) {
+    if (segment_size < 4096) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("journal error: segment size %u too small", segment_size);
+        return nullptr;
+    }
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("journal error: can't create %s", directory.c_str());
+        return nullptr;
+    }
+    auto *journal = new Journal(directory, segment_size);
+    std::vector<std::string> existing = segments(directory);
+    journal->m_segment_sequence = 1;
+    if (!existing.empty()) {
+        const std::string &last = existing.back();
+        uint64_t sequence = 0;
+        parse_segment_sequence(last.c_str() + last.size() - 16 - strlen(journal_suffix), &sequence);
+        journal->m_segment_sequence = sequence + 1;
+    }
+    journal->m_batch = BuffersStorage::get().get_free_buffer(journal_batch_size, "Journal batch");
+    journal->m_batch->limit(journal_batch_size);
+    if (!journal->open_segment(error)) {
+        delete journal;
+        return nullptr;
+    }
+    return journal;
+}
+
+Journal::~Journal() {
+    pthread_mutex_lock(&m_mutex);
+    if (m_fd >= 0) {
+        flush_locked(nullptr);
+        if (fdatasync(m_fd) != 0) {
+            DEBUG_E("journal fdatasync error %d", errno);
+        }
+        close_segment();
+    }
+    if (m_batch != nullptr) {
+        m_batch->reuse();
+        m_batch = nullptr;
+    }
+    pthread_mutex_unlock(&m_mutex);
+    pthread_mutex_destroy(&m_mutex);
+    pthread_mutex_destroy(&m_sync_mutex);
+}
+
+std::vector<std::string> Journal::segments(const std::string &directory) {
+    std::vector<std::pair<uint64_t, std::string>> found;
+    DIR *dir = opendir(directory.c_str());
+    if (dir != nullptr) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            uint64_t sequence;
+            if (parse_segment_sequence(entry->d_name, &sequence)) {
+                found.emplace_back(sequence, directory + "/" + entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<std::string> result;
+    result.reserve(found.size());
+    for (auto &item : found) {
+        result.push_back(std::move(item.second));
+    }
+    return result;
+}
+
+bool Journal::open_segment(bool *error) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIu64 "%s", m_segment_sequence, journal_suffix);
+    std::string path = m_directory + "/" + name;
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("journal error: can't create segment %s", path.c_str());
+        return false;
+    }
+    if (posix_fallocate(m_fd, 0, m_segment_size) != 0 && ftruncate(m_fd, m_segment_size) != 0) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("journal error: can't preallocate segment %s", path.c_str());
+        close_segment();
+        return false;
+    }
+    fdatasync(m_fd);
+    int dir_fd = ::open(m_directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    m_offset = 0;
+    return true;
+}
+
+void Journal::close_segment() {
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool Journal::write_locked(const uint8_t *data, uint32_t len, bool *error) {
+    struct iovec iov{};
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+    if (!write_fully(m_fd, &iov, 1, m_offset)) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("journal write error %d", errno);
+        return false;
+    }
+    m_offset += len;
+    return true;
+}
+
+bool Journal::flush_locked(bool *error) {
+    if (m_batch->position() > 0) {
+        if (!write_locked(m_batch->bytes(), m_batch->position(), error)) {
+            return false;
+        }
+        m_batch->rewind();
+    }
+    m_written = m_appended;
+    return true;
+}
+
+uint64_t Journal::append(ProtoBuffer *buffer, bool *error) {
+    if (buffer == nullptr) {
+        return 0;
+    }
+    uint32_t len = buffer->remaining();
+    uint32_t frame_size = frame_header_size + len + frame_padding(len);
+    if ((uint64_t) frame_size > m_segment_size) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("journal error: frame of %u bytes exceeds segment size", len);
+        return 0;
+    }
+    const uint8_t *payload = buffer->bytes() + buffer->position();
+    uint32_t crc = mask_crc(Crc32c::compute(payload, len));
+
+    pthread_mutex_lock(&m_mutex);
+    if (m_fd < 0) {
+        pthread_mutex_unlock(&m_mutex);
+        if (error != nullptr) {
+            *error = true;
+        }
+        return 0;
+    }
+    if (m_offset + m_batch->position() + frame_size > m_segment_size) {
+        if (!flush_locked(error)) {
+            pthread_mutex_unlock(&m_mutex);
+            return 0;
+        }
+        // The old segment must be durable before the next one is opened: commit() only syncs
+        // the current segment, so m_synced would otherwise pass frames that never reached disk.
+        // On failure the segment is kept and the next append retries.
+        if (fdatasync(m_fd) != 0) {
+            pthread_mutex_unlock(&m_mutex);
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("journal fdatasync error %d", errno);
+            return 0;
+        }
+        close_segment();
+        m_segment_sequence++;
+        if (!open_segment(error)) {
+            pthread_mutex_unlock(&m_mutex);
+            return 0;
+        }
+    }
+    if (frame_size > m_batch->remaining()) {
+        if (!flush_locked(error)) {
+            pthread_mutex_unlock(&m_mutex);
+            return 0;
+        }
+    }
+    if (frame_size <= m_batch->remaining()) {
+        m_batch->write_int(len);
+        m_batch->write_int(crc);
+        m_batch->write_bytes((uint8_t *) payload, len);
+        for (uint32_t a = frame_size - frame_header_size - len; a > 0; a--) {
+            m_batch->write_byte(0);
+        }
+    } else {
+        uint8_t header[frame_header_size + 4] = {};
+        ProtoBuffer header_buffer(header, frame_header_size);
+        header_buffer.write_int(len);
+        header_buffer.write_int(crc);
+        struct iovec iov[3];
+        iov[0].iov_base = header;
+        iov[0].iov_len = frame_header_size;
+        iov[1].iov_base = (void *) payload;
+        iov[1].iov_len = len;
+        iov[2].iov_base = header + frame_header_size;
+        iov[2].iov_len = frame_padding(len);
+        if (!write_fully(m_fd, iov, 3, m_offset)) {
+            pthread_mutex_unlock(&m_mutex);
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("journal write error %d", errno);
+            return 0;
+        }
+        m_offset += frame_size;
+    }
+    uint64_t sequence = ++m_appended;
+    pthread_mutex_unlock(&m_mutex);
+    return sequence;
+}
+
+void Journal::flush(bool *error) {
+    pthread_mutex_lock(&m_mutex);
+    if (m_fd >= 0) {
+        flush_locked(error);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void Journal::commit(uint64_t sequence, bool *error) {
+    pthread_mutex_lock(&m_sync_mutex);
+    if (m_synced >= sequence) {
+        pthread_mutex_unlock(&m_sync_mutex);
+        return;
+    }
+    pthread_mutex_lock(&m_mutex);
+    if (sequence == UINT64_MAX && m_synced == m_appended) {
+        pthread_mutex_unlock(&m_mutex);
+        pthread_mutex_unlock(&m_sync_mutex);
+        return;
+    }
+    bool ok = m_fd >= 0 && flush_locked(error);
+    uint64_t written = m_written;
+    int fd = ok ? dup(m_fd) : -1;
+    pthread_mutex_unlock(&m_mutex);
+    if (fd >= 0) {
+        if (fdatasync(fd) == 0) {
+            m_synced = written;
+        } else {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("journal fdatasync error %d", errno);
+        }
+        close(fd);
+    }
+    pthread_mutex_unlock(&m_sync_mutex);
+}
+
+JournalReader::JournalReader(const std::string &directory) : m_segments(Journal::segments(directory)) {
+}
+
+JournalReader::~JournalReader() {
+    delete m_map;
+}
+
+bool JournalReader::map_next_segment(bool *error) {
+    delete m_map;
+    m_map = nullptr;
+    while (m_segment_index < m_segments.size()) {
+        m_map = ProtoBuffer::map_file(m_segments[m_segment_index++].c_str(), false, 0, error);
+        if (m_map != nullptr) {
+            m_map->advise(ProtoBuffer::MapAdvice::sequential);
+            m_offset = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+ProtoBuffer *JournalReader::next(bool *error) {
+    while (true) {
+        if (m_map == nullptr && !map_next_segment(error)) {
+            return nullptr;
+        }
+        m_map->clear();
+        uint32_t capacity = m_map->capacity();
+        if (m_offset + frame_header_size > capacity) {
+            delete m_map;
+            m_map = nullptr;
+            continue;
+        }
+        m_map->position(m_offset);
+        uint32_t len = m_map->read_u_int();
+        uint32_t crc = m_map->read_u_int();
+        if (len == 0 && crc == 0) {
+            delete m_map;
+            m_map = nullptr;
+            continue;
+        }
+        uint32_t start = m_offset + frame_header_size;
+        if ((uint64_t) start + len > capacity ||
+            mask_crc(Crc32c::compute(m_map->bytes() + start, len)) != crc) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("journal reader: corrupt frame at offset %u", m_offset);
+            delete m_map;
+            m_map = nullptr;
+            continue;
+        }
+        m_map->limit(start + len);
+        m_map->position(start);
+        m_offset = start + len + frame_padding(len);
+        return m_map;
+    }
+}
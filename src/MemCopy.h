@@ -0,0 +1,112 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_MEM_COPY_H
+#define TKS_PROTO_BUFFER_MEM_COPY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Copies at or above this size bypass the cache with non-temporal stores. Measured with
+ * buffer_bench mem_copy, streaming only wins past ~512KB, so every pooled size class (up to
+ * 160000 bytes) stays cached and only oversized buffers are streamed.
+ */
+#ifndef TKS_NON_TEMPORAL_THRESHOLD
+#define TKS_NON_TEMPORAL_THRESHOLD (512 * 1024)
+#endif
+
+/*
+ * Up to 32 bytes: two possibly overlapping fixed-size loads followed by two stores, so no
+ * call and no loop. Both loads happen before the stores, which also makes it safe for
+ * overlapping ranges.
+ */
+static inline void small_copy(uint8_t *dst, const uint8_t *src, size_t len) {
+    if (len >= 16) {
+        uint8_t head[16], tail[16];
+        memcpy(head, src, 16);
+        memcpy(tail, src + len - 16, 16);
+        memcpy(dst, head, 16);
+        memcpy(dst + len - 16, tail, 16);
+    } else if (len >= 8) {
+        uint64_t head, tail;
+        memcpy(&head, src, 8);
+        memcpy(&tail, src + len - 8, 8);
+        memcpy(dst, &head, 8);
+        memcpy(dst + len - 8, &tail, 8);
+    } else if (len >= 4) {
+        uint32_t head, tail;
+        memcpy(&head, src, 4);
+        memcpy(&tail, src + len - 4, 4);
+        memcpy(dst, &head, 4);
+        memcpy(dst + len - 4, &tail, 4);
+    } else if (len > 0) {
+        uint8_t first = src[0];
+        uint8_t middle = src[len >> 1];
+        uint8_t last = src[len - 1];
+        dst[0] = first;
+        dst[len >> 1] = middle;
+        dst[len - 1] = last;
+    }
+}
+
+static inline void stream_copy(uint8_t *dst, const uint8_t *src, size_t len) {
+#if defined(__SSE2__)
+    size_t head = (16 - ((uintptr_t) dst & 15)) & 15;
+    memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+    while (len >= 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *) src);
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (src + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *) (src + 48));
+        _mm_stream_si128((__m128i *) dst, a);
+        _mm_stream_si128((__m128i *) (dst + 16), b);
+        _mm_stream_si128((__m128i *) (dst + 32), c);
+        _mm_stream_si128((__m128i *) (dst + 48), d);
+        src += 64;
+        dst += 64;
+        len -= 64;
+    }
+    _mm_sfence();
+    memcpy(dst, src, len);
+#else
+    memcpy(dst, src, len);
+#endif
+}
+
+/*
+ * Non-overlapping copy used by the write paths and ByteStream::get.
+ */
+static inline void buffer_copy(uint8_t *dst, const uint8_t *src, size_t len) {
+    if (len <= 32) {
+        small_copy(dst, src, len);
+    } else if (len >= TKS_NON_TEMPORAL_THRESHOLD) {
+        stream_copy(dst, src, len);
+    } else {
+        memcpy(dst, src, len);
+    }
+}
+
+/*
+ * Overlap-safe copy used by compact().
+ */
+static inline void buffer_move(uint8_t *dst, const uint8_t *src, size_t len) {
+    if (len <= 32) {
+        small_copy(dst, src, len);
+    } else {
+        memmove(dst, src, len);
+    }
+}
+
+#endif //TKS_PROTO_BUFFER_MEM_COPY_H
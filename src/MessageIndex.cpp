@@ -0,0 +1,130 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "MessageIndex.h"
+
+static inline uint32_t load_le32(const uint8_t *p) {
+    return p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+bool MessageIndex::scan(ProtoBuffer *buffer, bool *error) {
+    clear();
+    if (buffer == nullptr) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("message index error: null buffer");
+        return false;
+    }
+    uint8_t *bytes = buffer->bytes();
+    uint32_t position = buffer->position();
+    uint32_t limit = buffer->limit();
+    if (limit - position < 4) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("message index error: truncated container");
+        return false;
+    }
+    uint32_t count = load_le32(bytes + position);
+    position += 4;
+    if (count == vector_constructor) {
+        if (limit - position < 4) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("message index error: truncated container");
+            return false;
+        }
+        count = load_le32(bytes + position);
+        position += 4;
+    }
+    if (count > (limit - position) / 4) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("message index error: count %u does not fit", count);
+        return false;
+    }
+    m_entries.reserve(count);
+    for (uint32_t a = 0; a < count; a++) {
+        if (position >= limit) {
+            break;
+        }
+        uint32_t length = bytes[position];
+        uint32_t header = 1;
+        if (length >= 254) {
+            if (limit - position < 4) {
+                break;
+            }
+            length = bytes[position + 1] | ((uint32_t) bytes[position + 2] << 8) |
+                     ((uint32_t) bytes[position + 3] << 16);
+            header = 4;
+        }
+        uint32_t padded = (header + length + 3) & ~3u;
+        if ((uint64_t) padded > limit - position) {
+            break;
+        }
+        Entry entry{};
+        entry.offset = position + header;
+        entry.length = length;
+        entry.constructor = length >= 4 ? load_le32(bytes + entry.offset) : 0;
+        m_entries.push_back(entry);
+        position += padded;
+    }
+    if (m_entries.size() != count) {
+        clear();
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("message index error: container truncated after %u of %u messages", (uint32_t) m_entries.size(),
+                count);
+        return false;
+    }
+    m_bytes = bytes;
+    m_end = position;
+    return true;
+}
+
+uint32_t MessageIndex::size() const {
+    return (uint32_t) m_entries.size();
+}
+
+const MessageIndex::Entry &MessageIndex::entry(uint32_t index) const {
+    return m_entries[index];
+}
+
+uint32_t MessageIndex::end() const {
+    return m_end;
+}
+
+uint8_t *MessageIndex::bytes(uint32_t index) const {
+    return m_bytes + m_entries[index].offset;
+}
+
+ProtoBuffer *MessageIndex::slice(uint32_t index) const {
+    if (index >= m_entries.size()) {
+        DEBUG_E("message index error: no message %u", index);
+        return nullptr;
+    }
+    return new ProtoBuffer(m_bytes + m_entries[index].offset, m_entries[index].length);
+}
+
+int32_t MessageIndex::find(uint32_t constructor, uint32_t from) const {
+    auto size = (uint32_t) m_entries.size();
+    for (uint32_t a = from; a < size; a++) {
+        if (m_entries[a].constructor == constructor) {
+            return (int32_t) a;
+        }
+    }
+    return -1;
+}
+
+void MessageIndex::clear() {
+    m_entries.clear();
+    m_bytes = nullptr;
+    m_end = 0;
+}
@@ -8,11 +8,21 @@
 
 #include "Bytes.h"
 #include "BuffersStorage.h"
+#include "ByteSwap.h"
+#include "MemCopy.h"
+#include "StringInterner.h"
+#include "Utf8.h"
+#include "Varint.h"
 #ifdef ANDROID
 #endif
+#include <cerrno>
 #include <cstdlib>
 #include <memory>
 #include <memory.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 ProtoBuffer::ProtoBuffer(uint32_t size) {
 #ifdef ANDROID
@@ -68,14 +78,125 @@ ProtoBuffer::~ProtoBuffer() {
         m_java_byte_buffer = nullptr;
     }
 #endif
+    if (m_mapped && m_buffer != nullptr) {
+        munmap(m_buffer, m_capacity);
+        m_buffer = nullptr;
+    }
     if (m_buffer_owner && !m_sliced && m_buffer != nullptr) {
         delete[] m_buffer;
         m_buffer = nullptr;
     }
 }
 
+ProtoBuffer *ProtoBuffer::map_file(const char *path, bool writable, uint32_t size, bool *error) {
+    if (!writable && size != 0) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("map file error: size %u given for read-only map of %s", size, path);
+        return nullptr;
+    }
+    // Only a sized writable map may create the file; remember whether it did, so a failure
+    // below doesn't leave an empty file behind.
+    bool created = false;
+    int fd;
+    if (!writable) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    } else if (size == 0) {
+        fd = open(path, O_RDWR | O_CLOEXEC);
+    } else {
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        created = fd >= 0;
+        if (fd < 0 && errno == EEXIST) {
+            fd = open(path, O_RDWR | O_CLOEXEC);
+        }
+    }
+    if (fd < 0) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("map file error: can't open %s", path);
+        return nullptr;
+    }
+    auto fail = [&](const char *reason) -> ProtoBuffer * {
+        (void) reason;
+        close(fd);
+        if (created) {
+            unlink(path);
+        }
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("map file error: %s %s", reason, path);
+        return nullptr;
+    };
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        return fail("can't stat");
+    }
+    if (writable && size != 0 && (uint64_t) st.st_size != size) {
+        if (ftruncate(fd, size) != 0) {
+            return fail("can't resize");
+        }
+        st.st_size = size;
+    }
+    if (st.st_size == 0 || (uint64_t) st.st_size > UINT32_MAX) {
+        return fail("unsupported size for");
+    }
+    auto length = (uint32_t) st.st_size;
+    void *address = mmap(nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                         writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (address == MAP_FAILED) {
+        return fail("can't map");
+    }
+    close(fd);
+    auto *result = new ProtoBuffer((uint8_t *) address, length);
+    result->m_mapped = true;
+    return result;
+}
+
+bool ProtoBuffer::mapped() const {
+    return m_mapped;
+}
+
+void ProtoBuffer::advise(MapAdvice advice) {
+    if (!m_mapped) {
+        return;
+    }
+    int value = MADV_NORMAL;
+    switch (advice) {
+        case MapAdvice::normal:
+            value = MADV_NORMAL;
+            break;
+        case MapAdvice::sequential:
+            value = MADV_SEQUENTIAL;
+            break;
+        case MapAdvice::random:
+            value = MADV_RANDOM;
+            break;
+        case MapAdvice::will_need:
+            value = MADV_WILLNEED;
+            break;
+    }
+    if (madvise(m_buffer, m_capacity, value) != 0) {
+        DEBUG_E("madvise error");
+    }
+}
+
+void ProtoBuffer::sync(bool *error) {
+    if (!m_mapped) {
+        return;
+    }
+    if (msync(m_buffer, m_capacity, MS_SYNC) != 0) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("msync error");
+    }
+}
+
 void ProtoBuffer::write_bytes_internal(uint8_t *b, uint32_t offset, uint32_t len) {
-    memcpy(m_buffer + m_position, b + offset, sizeof(uint8_t) * len);
+    buffer_copy(m_buffer + m_position, b + offset, len);
     m_position += len;
 }
 
@@ -124,7 +245,7 @@ void ProtoBuffer::compact() {
     if (m_position == m_limit) {
         return;
     }
-    memmove(m_buffer, m_buffer + m_position, sizeof(uint8_t) * (m_limit - m_position));
+    buffer_move(m_buffer, m_buffer + m_position, m_limit - m_position);
     m_position = (m_limit - m_position);
     m_limit = m_capacity;
 }
@@ -157,6 +278,14 @@ void ProtoBuffer::clear_capacity() {
     m_capacity = 0;
 }
 
+bool ProtoBuffer::validate_utf8() const {
+    return m_validate_utf8;
+}
+
+void ProtoBuffer::validate_utf8(bool validate) {
+    m_validate_utf8 = validate;
+}
+
 uint8_t *ProtoBuffer::bytes() {
     return m_buffer;
 }
@@ -383,12 +512,117 @@ void ProtoBuffer::write_byte_array(ProtoBuffer *buff, bool *error) {
     write_byte_array(buff->m_buffer, 0, buff->limit(), error);
 }
 
+uint32_t ProtoBuffer::byte_array_size(uint32_t length) {
+    uint32_t header = length <= 253 ? 1 : 4;
+    return (header + length + 3) & ~3u;
+}
+
 void ProtoBuffer::write_double(double d, bool *error) {
     int64_t value;
     memcpy(&value, &d, sizeof(int64_t));
     write_long(value, error);
 }
 
+void ProtoBuffer::write_varint(uint64_t x, bool *error) {
+    if (!m_calculate_size_only) {
+        if (m_position + ::varint_size(x) > m_limit) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("write varint error");
+            return;
+        }
+        m_position += varint_encode(m_buffer + m_position, x);
+    } else {
+        m_capacity += ::varint_size(x);
+    }
+}
+
+void ProtoBuffer::write_zigzag(int64_t x, bool *error) {
+    write_varint(zigzag_encode(x), error);
+}
+
+void ProtoBuffer::write_tag(uint32_t field, WireType type, bool *error) {
+    write_varint(((uint64_t) field << 3) | (uint32_t) type, error);
+}
+
+void ProtoBuffer::write_length_delimited(const uint8_t *b, uint32_t len, bool *error) {
+    if (!m_calculate_size_only) {
+        if ((uint64_t) m_position + ::varint_size(len) + len > m_limit) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("write length delimited error");
+            return;
+        }
+        m_position += varint_encode(m_buffer + m_position, len);
+        write_bytes_internal((uint8_t *) b, 0, len);
+    } else {
+        m_capacity += ::varint_size(len) + len;
+    }
+}
+
+void ProtoBuffer::write_length_delimited(const std::string &s, bool *error) {
+    write_length_delimited((const uint8_t *) s.data(), (uint32_t) s.size(), error);
+}
+
+uint32_t ProtoBuffer::varint_size(uint64_t x) {
+    return ::varint_size(x);
+}
+
+void ProtoBuffer::write_int_array(const int32_t *values, uint32_t count, bool *error) {
+    if (!m_calculate_size_only) {
+        if ((uint64_t) m_position + (uint64_t) count * 4 > m_limit) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("write int32 array error");
+            return;
+        }
+        le_copy32(m_buffer + m_position, (const uint8_t *) values, count);
+        m_position += count * 4;
+    } else {
+        m_capacity += count * 4;
+    }
+}
+
+void ProtoBuffer::write_int_array_BE(const int32_t *values, uint32_t count, bool *error) {
+    if (!m_calculate_size_only) {
+        if ((uint64_t) m_position + (uint64_t) count * 4 > m_limit) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("write big int32 array error");
+            return;
+        }
+        be_copy32(m_buffer + m_position, (const uint8_t *) values, count);
+        m_position += count * 4;
+    } else {
+        m_capacity += count * 4;
+    }
+}
+
+void ProtoBuffer::write_long_array(const int64_t *values, uint32_t count, bool *error) {
+    if (!m_calculate_size_only) {
+        if ((uint64_t) m_position + (uint64_t) count * 8 > m_limit) {
+            if (error != nullptr) {
+                *error = true;
+            }
+            DEBUG_E("write int64 array error");
+            return;
+        }
+        le_copy64(m_buffer + m_position, (const uint8_t *) values, count);
+        m_position += count * 8;
+    } else {
+        m_capacity += count * 8;
+    }
+}
+
+void ProtoBuffer::write_double_array(const double *values, uint32_t count, bool *error) {
+    static_assert(sizeof(double) == sizeof(int64_t), "double must be 64-bit");
+    write_long_array((const int64_t *) values, count, error);
+}
+
 int32_t ProtoBuffer::read_int(bool *error) {
     if (m_position + 4 > m_limit) {
         if (error != nullptr) {
@@ -426,7 +660,7 @@ int32_t ProtoBuffer::read_int_BE(bool *error) {
 }
 
 int64_t ProtoBuffer::read_long(bool *error) {
-    if (m_position + 4 > m_limit) {
+    if (m_position + 8 > m_limit) {
         if (error != nullptr) {
             *error = true;
         }
@@ -464,7 +698,7 @@ void ProtoBuffer::read_bytes(uint8_t *b, uint32_t len, bool *error) {
         DEBUG_E("read bytes error");
         return;
     }
-    memcpy(b, m_buffer + m_position, len);
+    buffer_copy(b, m_buffer + m_position, len);
     m_position += len;
 }
 
@@ -477,19 +711,19 @@ Bytes *ProtoBuffer::read_bytes(uint32_t len, bool *error) {
         return nullptr;
     }
     auto *byteArray = new Bytes(len);
-    memcpy(byteArray->bytes(), m_buffer + m_position, sizeof(uint8_t) * len);
+    buffer_copy(byteArray->bytes(), m_buffer + m_position, len);
     m_position += len;
     return byteArray;
 }
 
-std::string ProtoBuffer::read_string(bool *error) {
+const char *ProtoBuffer::read_string_internal(uint32_t *length, bool *error) {
     uint32_t sl = 1;
     if (m_position + 1 > m_limit) {
         if (error != nullptr) {
             *error = true;
         }
         DEBUG_E("read string error. position is %d. limit is %d", m_position, m_limit);
-        return "";
+        return nullptr;
     }
     uint32_t l = m_buffer[m_position++];
     if (l >= 254) {
@@ -498,7 +732,7 @@ std::string ProtoBuffer::read_string(bool *error) {
                 *error = true;
             }
             DEBUG_E("read string error2");
-            return "";
+            return nullptr;
         }
         l = m_buffer[m_position] | (m_buffer[m_position + 1] << 8) | (m_buffer[m_position + 2] << 16);
         m_position += 3;
@@ -513,13 +747,51 @@ std::string ProtoBuffer::read_string(bool *error) {
             *error = true;
         }
         DEBUG_E("read string error position %d limit %d", m_position, m_limit);
-        return "";
+        return nullptr;
+    }
+    if (m_validate_utf8 && !utf8_validate(m_buffer + m_position, l)) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("read string error: invalid utf-8 at position %d", m_position);
+        return nullptr;
     }
-    std::string result = std::string((const char *) (m_buffer + m_position), l);
+    auto result = (const char *) (m_buffer + m_position);
     m_position += l + addition;
+    *length = l;
     return result;
 }
 
+std::string ProtoBuffer::read_string(bool *error) {
+    uint32_t length = 0;
+    const char *bytes = read_string_internal(&length, error);
+    if (bytes == nullptr) {
+        return "";
+    }
+    return std::string(bytes, length);
+}
+
+std::string_view ProtoBuffer::read_string_view(bool *error) {
+    uint32_t length = 0;
+    const char *bytes = read_string_internal(&length, error);
+    if (bytes == nullptr) {
+        return {};
+    }
+    return std::string_view(bytes, length);
+}
+
+std::shared_ptr<const std::string> ProtoBuffer::read_interned_string(StringInterner *interner, bool *error) {
+    uint32_t length = 0;
+    const char *bytes = read_string_internal(&length, error);
+    if (bytes == nullptr) {
+        return nullptr;
+    }
+    if (interner == nullptr) {
+        interner = &StringInterner::current();
+    }
+    return interner->intern(bytes, length);
+}
+
 Bytes *ProtoBuffer::read_byte_array(bool *error) {
     uint32_t sl = 1;
     if (m_position + 1 > m_limit) {
@@ -555,7 +827,7 @@ Bytes *ProtoBuffer::read_byte_array(bool *error) {
         return nullptr;
     }
     auto *result = new Bytes(l);
-    memcpy(result->bytes(), m_buffer + m_position, sizeof(uint8_t) * l);
+    buffer_copy(result->bytes(), m_buffer + m_position, l);
     m_position += l + addition;
     return result;
 }
@@ -596,8 +868,8 @@ ProtoBuffer *ProtoBuffer::read_proto_buff(bool copy, bool *error) {
     }
     ProtoBuffer *result;
     if (copy) {
-        result = BuffersStorage::get().get_free_buffer(l);
-        memcpy(result->m_buffer, m_buffer + m_position, sizeof(uint8_t) * l);
+        result = BuffersStorage::get().get_free_buffer(l, "read_proto_buff copy");
+        buffer_copy(result->m_buffer, m_buffer + m_position, l);
     } else {
         result = new ProtoBuffer(m_buffer + m_position, l);
     }
@@ -612,6 +884,130 @@ double ProtoBuffer::read_double(bool *error) {
     return value;
 }
 
+uint64_t ProtoBuffer::read_varint(bool *error) {
+    uint64_t value = 0;
+    uint32_t available = m_limit - m_position;
+    uint32_t length;
+    if (available >= 8) {
+        length = varint_decode_fast(m_buffer + m_position, available, &value);
+    } else {
+        length = varint_decode_slow(m_buffer + m_position, available, &value);
+    }
+    if (length == 0) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("read varint error");
+        return 0;
+    }
+    m_position += length;
+    return value;
+}
+
+int64_t ProtoBuffer::read_zigzag(bool *error) {
+    return zigzag_decode(read_varint(error));
+}
+
+uint32_t ProtoBuffer::read_tag(WireType *type, bool *error) {
+    bool read_error = false;
+    uint64_t key = read_varint(&read_error);
+    uint32_t wire = (uint32_t) key & 7;
+    uint64_t field = key >> 3;
+    if (read_error || field == 0 || field > 0x1fffffff ||
+        (wire != 0 && wire != 1 && wire != 2 && wire != 5)) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("read tag error");
+        return 0;
+    }
+    *type = (WireType) wire;
+    return (uint32_t) field;
+}
+
+std::string_view ProtoBuffer::read_length_delimited(bool *error) {
+    uint32_t position = m_position;
+    bool read_error = false;
+    uint64_t length = read_varint(&read_error);
+    if (read_error || length > m_limit - m_position) {
+        m_position = position;
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("read length delimited error");
+        return {};
+    }
+    auto view = std::string_view((const char *) m_buffer + m_position, (size_t) length);
+    m_position += (uint32_t) length;
+    return view;
+}
+
+void ProtoBuffer::skip_field(WireType type, bool *error) {
+    uint32_t length = 0;
+    switch (type) {
+        case WireType::varint:
+            read_varint(error);
+            return;
+        case WireType::length_delimited:
+            read_length_delimited(error);
+            return;
+        case WireType::fixed64:
+            length = 8;
+            break;
+        case WireType::fixed32:
+            length = 4;
+            break;
+    }
+    if (m_position + length > m_limit) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("skip field error");
+        return;
+    }
+    m_position += length;
+}
+
+void ProtoBuffer::read_int_array(int32_t *values, uint32_t count, bool *error) {
+    if ((uint64_t) m_position + (uint64_t) count * 4 > m_limit) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("read int32 array error");
+        return;
+    }
+    le_copy32((uint8_t *) values, m_buffer + m_position, count);
+    m_position += count * 4;
+}
+
+void ProtoBuffer::read_int_array_BE(int32_t *values, uint32_t count, bool *error) {
+    if ((uint64_t) m_position + (uint64_t) count * 4 > m_limit) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("read big int32 array error");
+        return;
+    }
+    be_copy32((uint8_t *) values, m_buffer + m_position, count);
+    m_position += count * 4;
+}
+
+void ProtoBuffer::read_long_array(int64_t *values, uint32_t count, bool *error) {
+    if ((uint64_t) m_position + (uint64_t) count * 8 > m_limit) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("read int64 array error");
+        return;
+    }
+    le_copy64((uint8_t *) values, m_buffer + m_position, count);
+    m_position += count * 8;
+}
+
+void ProtoBuffer::read_double_array(double *values, uint32_t count, bool *error) {
+    read_long_array((int64_t *) values, count, error);
+}
+
 void ProtoBuffer::reuse() {
     if (m_sliced) {
         return;
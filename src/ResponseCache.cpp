@@ -0,0 +1,173 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "ResponseCache.h"
+#include "ByteStream.h"
+#include "Checksum.h"
+#include "ProtoBuffer.h"
+#include <memory.h>
+
+ResponseCache::ResponseCache(uint64_t max_bytes) : m_max_bytes(max_bytes) {
+    pthread_mutex_init(&m_mutex, nullptr);
+}
+
+ResponseCache::~ResponseCache() {
+    clear();
+    pthread_mutex_destroy(&m_mutex);
+}
+
+uint64_t ResponseCache::content_key(ProtoBuffer *buffer) {
+    return XxHash64::compute(buffer->bytes() + buffer->position(), buffer->remaining());
+}
+
+ResponseCache::Entry ResponseCache::make_entry(ProtoBuffer *buffer) {
+    // The last reference, cache or stream, hands the buffer back to the pool.
+    return Entry(buffer, [](const ProtoBuffer *released) {
+        const_cast<ProtoBuffer *>(released)->reuse();
+    });
+}
+
+ResponseCache::Entry ResponseCache::find(uint64_t key) {
+    pthread_mutex_lock(&m_mutex);
+    auto found = m_items.find(key);
+    if (found == m_items.end()) {
+        m_misses++;
+        pthread_mutex_unlock(&m_mutex);
+        return nullptr;
+    }
+    m_hits++;
+    m_lru.splice(m_lru.begin(), m_lru, found->second);
+    Entry entry = found->second->entry;
+    pthread_mutex_unlock(&m_mutex);
+    return entry;
+}
+
+bool ResponseCache::append_to(uint64_t key, ByteStream *stream) {
+    Entry entry = find(key);
+    if (entry == nullptr) {
+        return false;
+    }
+    stream->append_shared(entry);
+    return true;
+}
+
+ResponseCache::Entry ResponseCache::put(uint64_t key, ProtoBuffer *buffer) {
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+    pthread_mutex_lock(&m_mutex);
+    Entry entry = insert_locked(key, buffer);
+    pthread_mutex_unlock(&m_mutex);
+    return entry;
+}
+
+ResponseCache::Entry ResponseCache::put(ProtoBuffer *buffer, uint64_t *key) {
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+    uint64_t content = content_key(buffer);
+    pthread_mutex_lock(&m_mutex);
+    auto found = m_items.find(content);
+    if (found != m_items.end()) {
+        Entry existing = found->second->entry;
+        auto *cached = const_cast<ProtoBuffer *>(existing.get());
+        if (cached->remaining() != buffer->remaining() ||
+            memcmp(cached->bytes() + cached->position(), buffer->bytes() + buffer->position(), buffer->remaining()) != 0) {
+            // Different bytes under the same hash: the key already names the cached entry, so
+            // this one is handed back uncached rather than silently replacing it.
+            pthread_mutex_unlock(&m_mutex);
+            DEBUG_E("response cache: content key collision, not caching");
+            return make_entry(buffer);
+        }
+        m_lru.splice(m_lru.begin(), m_lru, found->second);
+        pthread_mutex_unlock(&m_mutex);
+        buffer->reuse();
+        if (key != nullptr) {
+            *key = content;
+        }
+        return existing;
+    }
+    Entry entry = insert_locked(content, buffer);
+    pthread_mutex_unlock(&m_mutex);
+    if (key != nullptr) {
+        *key = content;
+    }
+    return entry;
+}
+
+ResponseCache::Entry ResponseCache::insert_locked(uint64_t key, ProtoBuffer *buffer) {
+    Entry entry = make_entry(buffer);
+    uint64_t cost = buffer->capacity();
+    auto found = m_items.find(key);
+    if (found != m_items.end()) {
+        erase_locked(found->second);
+    }
+    if (cost > m_max_bytes) {
+        return entry;
+    }
+    while (m_bytes + cost > m_max_bytes && !m_lru.empty()) {
+        erase_locked(std::prev(m_lru.end()));
+    }
+    m_lru.push_front(Item{key, cost, entry});
+    m_items[key] = m_lru.begin();
+    m_bytes += cost;
+    return entry;
+}
+
+void ResponseCache::erase_locked(std::list<Item>::iterator item) {
+    m_bytes -= item->cost;
+    m_items.erase(item->key);
+    m_lru.erase(item);
+}
+
+void ResponseCache::remove(uint64_t key) {
+    pthread_mutex_lock(&m_mutex);
+    auto found = m_items.find(key);
+    if (found != m_items.end()) {
+        erase_locked(found->second);
+    }
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void ResponseCache::clear() {
+    pthread_mutex_lock(&m_mutex);
+    m_items.clear();
+    m_lru.clear();
+    m_bytes = 0;
+    pthread_mutex_unlock(&m_mutex);
+}
+
+uint32_t ResponseCache::size() {
+    pthread_mutex_lock(&m_mutex);
+    auto size = (uint32_t) m_items.size();
+    pthread_mutex_unlock(&m_mutex);
+    return size;
+}
+
+uint64_t ResponseCache::bytes() {
+    pthread_mutex_lock(&m_mutex);
+    uint64_t bytes = m_bytes;
+    pthread_mutex_unlock(&m_mutex);
+    return bytes;
+}
+
+uint64_t ResponseCache::max_bytes() const {
+    return m_max_bytes;
+}
+
+uint64_t ResponseCache::hits() {
+    pthread_mutex_lock(&m_mutex);
+    uint64_t hits = m_hits;
+    pthread_mutex_unlock(&m_mutex);
+    return hits;
+}
+
+uint64_t ResponseCache::misses() {
+    pthread_mutex_lock(&m_mutex);
+    uint64_t misses = m_misses;
+    pthread_mutex_unlock(&m_mutex);
+    return misses;
+}
@@ -0,0 +1,262 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "SharedRing.h"
+#include "ProtoBuffer.h"
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+static const uint32_t ring_magic = 0x52425546;
+static const uint32_t slot_header_size = 8;
+static const uint32_t cache_line = 64;
+
+struct SharedRing::Header {
+    uint32_t magic;
+    uint32_t slot_size;
+    uint32_t slot_count;
+    uint32_t stride;
+    alignas(cache_line) std::atomic<uint32_t> head;
+    std::atomic<uint32_t> consumer_waiting;
+    alignas(cache_line) std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> producer_waiting;
+};
+
+static const uint32_t header_size = 3 * cache_line;
+
+static void futex_wait(std::atomic<uint32_t> *word, uint32_t expected, int32_t timeout_ms) {
+#ifdef __linux__
+    struct timespec timeout{};
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long) (timeout_ms % 1000) * 1000000L;
+    syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT, expected, timeout_ms < 0 ? nullptr : &timeout, nullptr, 0);
+#else
+    (void) word;
+    (void) expected;
+    usleep(timeout_ms < 0 || timeout_ms > 1 ? 1000 : (useconds_t) timeout_ms * 1000);
+#endif
+}
+
+static void futex_wake(std::atomic<uint32_t> *word) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void) word;
+#endif
+}
+
+SharedRing::SharedRing(int fd, uint8_t *memory, size_t size, uint32_t slot_size, uint32_t slot_count,
+                       uint32_t stride) : m_fd(fd), m_memory(memory), m_size(size), m_header((Header *) memory),
+                                          m_slot_size(slot_size), m_slot_count(slot_count), m_stride(stride) {
+    static_assert(sizeof(Header) <= header_size, "ring header does not fit");
+    m_slots.reserve(m_slot_count);
+    for (uint32_t a = 0; a < m_slot_count; a++) {
+        uint8_t *slot = m_memory + header_size + (size_t) a * m_stride;
+        m_slots.emplace_back(new ProtoBuffer(slot + slot_header_size, m_slot_size));
+    }
+}
+
+SharedRing *SharedRing::create(uint32_t slot_size, uint32_t slot_count, bool *error) {
+#ifdef __linux__
+    if (slot_size == 0 || slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("shared ring error: slot count must be a power of two");
+        return nullptr;
+    }
+    uint32_t stride = (slot_header_size + slot_size + cache_line - 1) / cache_line * cache_line;
+    size_t size = header_size + (size_t) stride * slot_count;
+    int fd = (int) syscall(SYS_memfd_create, "buffer-shared-ring", 0);
+    if (fd < 0 || ftruncate(fd, (off_t) size) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("shared ring error: can't create memfd");
+        return nullptr;
+    }
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        close(fd);
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("shared ring error: can't map memfd");
+        return nullptr;
+    }
+    auto *header = new(memory) Header();
+    header->slot_size = slot_size;
+    header->slot_count = slot_count;
+    header->stride = stride;
+    header->head.store(0);
+    header->tail.store(0);
+    header->consumer_waiting.store(0);
+    header->producer_waiting.store(0);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = ring_magic;
+    return new SharedRing(fd, (uint8_t *) memory, size, slot_size, slot_count, stride);
+#else
+    (void) slot_size;
+    (void) slot_count;
+    if (error != nullptr) {
+        *error = true;
+    }
+    DEBUG_E("shared ring error: not supported on this platform");
+    return nullptr;
+#endif
+}
+
+SharedRing *SharedRing::attach(int fd, bool *error) {
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t) st.st_size < header_size) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("shared ring error: bad descriptor");
+        return nullptr;
+    }
+    auto size = (size_t) st.st_size;
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("shared ring error: can't map descriptor");
+        return nullptr;
+    }
+    // The geometry is read once and kept in members: the peer can still write the header, so
+    // slot views and index masks must not depend on it after this check.
+    auto *header = (Header *) memory;
+    uint32_t magic = header->magic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t slot_size = header->slot_size;
+    uint32_t slot_count = header->slot_count;
+    uint32_t stride = header->stride;
+    if (magic != ring_magic || slot_size == 0 || slot_count == 0 || (slot_count & (slot_count - 1)) != 0 ||
+        stride % cache_line != 0 || (uint64_t) slot_header_size + slot_size > stride ||
+        header_size + (size_t) stride * slot_count > size) {
+        munmap(memory, size);
+        if (error != nullptr) {
+            *error = true;
+        }
+        DEBUG_E("shared ring error: descriptor is not a ring");
+        return nullptr;
+    }
+    int own_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    return new SharedRing(own_fd, (uint8_t *) memory, size, slot_size, slot_count, stride);
+}
+
+SharedRing::~SharedRing() {
+    m_slots.clear();
+    if (m_memory != nullptr) {
+        munmap(m_memory, m_size);
+        m_memory = nullptr;
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+int SharedRing::fd() const {
+    return m_fd;
+}
+
+uint32_t SharedRing::slot_size() const {
+    return m_slot_size;
+}
+
+uint32_t SharedRing::slot_count() const {
+    return m_slot_count;
+}
+
+ProtoBuffer *SharedRing::begin_write() {
+    uint32_t tail = m_header->tail.load(std::memory_order_relaxed);
+    uint32_t head = m_header->head.load(std::memory_order_acquire);
+    if (tail - head >= m_slot_count) {
+        return nullptr;
+    }
+    ProtoBuffer *slot = m_slots[tail & (m_slot_count - 1)].get();
+    slot->clear();
+    return slot;
+}
+
+void SharedRing::commit_write() {
+    uint32_t tail = m_header->tail.load(std::memory_order_relaxed);
+    uint32_t index = tail & (m_slot_count - 1);
+    uint32_t length = m_slots[index]->position();
+    memcpy(m_memory + header_size + (size_t) index * m_stride, &length, sizeof(length));
+    m_header->tail.store(tail + 1, std::memory_order_seq_cst);
+    if (m_header->consumer_waiting.load(std::memory_order_seq_cst) != 0) {
+        futex_wake(&m_header->tail);
+    }
+}
+
+bool SharedRing::wait_writable(int32_t timeout_ms) {
+    uint32_t tail = m_header->tail.load(std::memory_order_relaxed);
+    uint32_t head = m_header->head.load(std::memory_order_acquire);
+    if (tail - head < m_slot_count) {
+        return true;
+    }
+    m_header->producer_waiting.store(1, std::memory_order_seq_cst);
+    head = m_header->head.load(std::memory_order_seq_cst);
+    if (tail - head >= m_slot_count) {
+        futex_wait(&m_header->head, head, timeout_ms);
+    }
+    m_header->producer_waiting.store(0, std::memory_order_relaxed);
+    head = m_header->head.load(std::memory_order_acquire);
+    return tail - head < m_slot_count;
+}
+
+ProtoBuffer *SharedRing::begin_read() {
+    uint32_t head = m_header->head.load(std::memory_order_relaxed);
+    uint32_t tail = m_header->tail.load(std::memory_order_acquire);
+    if (head == tail) {
+        return nullptr;
+    }
+    uint32_t index = head & (m_slot_count - 1);
+    uint32_t length;
+    memcpy(&length, m_memory + header_size + (size_t) index * m_stride, sizeof(length));
+    ProtoBuffer *slot = m_slots[index].get();
+    slot->clear();
+    slot->limit(length < m_slot_size ? length : m_slot_size);
+    return slot;
+}
+
+void SharedRing::commit_read() {
+    uint32_t head = m_header->head.load(std::memory_order_relaxed);
+    m_header->head.store(head + 1, std::memory_order_seq_cst);
+    if (m_header->producer_waiting.load(std::memory_order_seq_cst) != 0) {
+        futex_wake(&m_header->head);
+    }
+}
+
+bool SharedRing::wait_readable(int32_t timeout_ms) {
+    uint32_t head = m_header->head.load(std::memory_order_relaxed);
+    if (m_header->tail.load(std::memory_order_acquire) != head) {
+        return true;
+    }
+    m_header->consumer_waiting.store(1, std::memory_order_seq_cst);
+    uint32_t tail = m_header->tail.load(std::memory_order_seq_cst);
+    if (tail == head) {
+        futex_wait(&m_header->tail, tail, timeout_ms);
+    }
+    m_header->consumer_waiting.store(0, std::memory_order_relaxed);
+    return m_header->tail.load(std::memory_order_acquire) != head;
+}
@@ -0,0 +1,91 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "StringInterner.h"
+#include "Checksum.h"
+#include <memory.h>
+
+StringInterner::StringInterner(uint32_t capacity, uint32_t max_length) {
+    uint32_t sets = 1;
+    while (sets * ways < capacity) {
+        sets <<= 1;
+    }
+    m_slots.resize((size_t) sets * ways, Slot{0, 0, nullptr});
+    m_set_mask = sets - 1;
+    m_max_length = max_length;
+}
+
+StringInterner &StringInterner::current() {
+    static thread_local StringInterner instance;
+    return instance;
+}
+
+StringInterner::Handle StringInterner::intern(const char *data, uint32_t length) {
+    if (length > m_max_length) {
+        return std::make_shared<const std::string>(data, length);
+    }
+    uint64_t hash = XxHash64::compute((const uint8_t *) data, length);
+    Slot *set = &m_slots[(size_t) ((uint32_t) hash & m_set_mask) * ways];
+    m_clock++;
+    Slot *victim = set;
+    for (uint32_t a = 0; a < ways; a++) {
+        Slot &slot = set[a];
+        if (slot.value == nullptr) {
+            if (victim->value != nullptr) {
+                victim = &slot;
+            }
+            continue;
+        }
+        if (slot.hash == hash && slot.value->size() == length && memcmp(slot.value->data(), data, length) == 0) {
+            slot.last_used = m_clock;
+            m_hits++;
+            return slot.value;
+        }
+        // Wrapping difference, so the order stays right when the clock overflows.
+        if (victim->value != nullptr && m_clock - slot.last_used > m_clock - victim->last_used) {
+            victim = &slot;
+        }
+    }
+    m_misses++;
+    if (victim->value == nullptr) {
+        m_size++;
+    }
+    victim->hash = hash;
+    victim->last_used = m_clock;
+    victim->value = std::make_shared<const std::string>(data, length);
+    return victim->value;
+}
+
+StringInterner::Handle StringInterner::intern(std::string_view value) {
+    return intern(value.data(), (uint32_t) value.size());
+}
+
+uint32_t StringInterner::capacity() const {
+    return (uint32_t) m_slots.size();
+}
+
+uint32_t StringInterner::max_length() const {
+    return m_max_length;
+}
+
+uint32_t StringInterner::size() const {
+    return m_size;
+}
+
+uint64_t StringInterner::hits() const {
+    return m_hits;
+}
+
+uint64_t StringInterner::misses() const {
+    return m_misses;
+}
+
+void StringInterner::clear() {
+    for (Slot &slot : m_slots) {
+        slot.value.reset();
+    }
+    m_size = 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "ThreadPool.h"
+#include <unistd.h>
+
+ThreadPool::ThreadPool(uint32_t threads) {
+    if (threads == 0) {
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = count > 0 ? (uint32_t) count : 1;
+    }
+    pthread_mutex_init(&m_mutex, nullptr);
+    pthread_cond_init(&m_wake, nullptr);
+    for (uint32_t a = 1; a < threads; a++) {
+        auto *worker = new Worker();
+        worker->pool = this;
+        worker->index = a - 1;
+        pthread_mutex_init(&worker->mutex, nullptr);
+        m_workers.push_back(worker);
+    }
+    for (Worker *worker : m_workers) {
+        pthread_create(&worker->thread, nullptr, run, worker);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    pthread_mutex_lock(&m_mutex);
+    m_stop = true;
+    pthread_cond_broadcast(&m_wake);
+    pthread_mutex_unlock(&m_mutex);
+    for (Worker *worker : m_workers) {
+        pthread_join(worker->thread, nullptr);
+        pthread_mutex_destroy(&worker->mutex);
+        delete worker;
+    }
+    m_workers.clear();
+    pthread_cond_destroy(&m_wake);
+    pthread_mutex_destroy(&m_mutex);
+}
+
+ThreadPool &ThreadPool::get() {
+    static ThreadPool instance{0};
+    return instance;
+}
+
+uint32_t ThreadPool::size() const {
+    return (uint32_t) m_workers.size() + 1;
+}
+
+void ThreadPool::execute(Task &task) {
+    Job *job = task.job;
+    (*job->body)(task.begin, task.end);
+    // Decrement under the job mutex: once the caller sees zero it destroys the job, so the
+    // last worker must be done with it by then.
+    pthread_mutex_lock(&job->mutex);
+    if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pthread_cond_signal(&job->done);
+    }
+    pthread_mutex_unlock(&job->mutex);
+}
+
+bool ThreadPool::take(uint32_t self, Task *task) {
+    auto count = (uint32_t) m_workers.size();
+    if (m_queued.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    uint32_t start = self < count ? self : 0;
+    for (uint32_t a = 0; a < count; a++) {
+        uint32_t index = (start + a) % count;
+        Worker *worker = m_workers[index];
+        pthread_mutex_lock(&worker->mutex);
+        if (!worker->tasks.empty()) {
+            if (index == self) {
+                *task = worker->tasks.front();
+                worker->tasks.pop_front();
+            } else {
+                *task = worker->tasks.back();
+                worker->tasks.pop_back();
+            }
+            pthread_mutex_unlock(&worker->mutex);
+            m_queued.fetch_sub(1, std::memory_order_acq_rel);
+            return true;
+        }
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    return false;
+}
+
+void *ThreadPool::run(void *arg) {
+    auto *worker = (Worker *) arg;
+    ThreadPool *pool = worker->pool;
+    Task task{};
+    while (true) {
+        if (pool->take(worker->index, &task)) {
+            execute(task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->m_mutex);
+        while (!pool->m_stop && pool->m_queued.load(std::memory_order_acquire) == 0) {
+            pthread_cond_wait(&pool->m_wake, &pool->m_mutex);
+        }
+        bool stop = pool->m_stop;
+        pthread_mutex_unlock(&pool->m_mutex);
+        if (stop) {
+            return nullptr;
+        }
+    }
+}
+
+void ThreadPool::parallel_for(uint32_t count, uint32_t grain, const std::function<void(uint32_t, uint32_t)> &body) {
+    if (count == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    uint32_t ranges = count / grain + (count % grain != 0 ? 1 : 0);
+    if (m_workers.empty() || ranges == 1) {
+        body(0, count);
+        return;
+    }
+
+    Job job{};
+    job.body = &body;
+    job.remaining.store(ranges, std::memory_order_relaxed);
+    pthread_mutex_init(&job.mutex, nullptr);
+    pthread_cond_init(&job.done, nullptr);
+
+    // Contiguous blocks of ranges per worker keep each worker on neighbouring memory until it
+    // runs dry and starts stealing.
+    auto workers = (uint32_t) m_workers.size();
+    m_queued.fetch_add(ranges, std::memory_order_acq_rel);
+    uint32_t per_worker = ranges / workers + (ranges % workers != 0 ? 1 : 0);
+    for (uint32_t w = 0; w < workers; w++) {
+        uint32_t first = w * per_worker;
+        uint32_t last = first + per_worker < ranges ? first + per_worker : ranges;
+        if (first >= last) {
+            break;
+        }
+        Worker *worker = m_workers[w];
+        pthread_mutex_lock(&worker->mutex);
+        for (uint32_t r = first; r < last; r++) {
+            uint32_t begin = r * grain;
+            uint32_t end = begin + grain < count ? begin + grain : count;
+            worker->tasks.push_back(Task{&job, begin, end});
+        }
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    pthread_mutex_lock(&m_mutex);
+    pthread_cond_broadcast(&m_wake);
+    pthread_mutex_unlock(&m_mutex);
+
+    Task task{};
+    while (job.remaining.load(std::memory_order_acquire) != 0 && take(workers, &task)) {
+        execute(task);
+    }
+    pthread_mutex_lock(&job.mutex);
+    while (job.remaining.load(std::memory_order_acquire) != 0) {
+        pthread_cond_wait(&job.done, &job.mutex);
+    }
+    pthread_mutex_unlock(&job.mutex);
+    pthread_cond_destroy(&job.done);
+    pthread_mutex_destroy(&job.mutex);
+}
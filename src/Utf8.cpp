@@ -0,0 +1,95 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#include "Utf8.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static inline uint32_t skip_ascii(const uint8_t *data, uint32_t position, uint32_t len) {
+#if defined(__AVX2__)
+    while (position + 32 <= len) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + position));
+        auto mask = (uint32_t) _mm256_movemask_epi8(v);
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+        position += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    while (position + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + position));
+        auto mask = (uint32_t) _mm_movemask_epi8(v);
+        if (mask != 0) {
+            return position + __builtin_ctz(mask);
+        }
+        position += 16;
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    while (position + 16 <= len) {
+        if (vmaxvq_u8(vld1q_u8(data + position)) >= 0x80) {
+            break;
+        }
+        position += 16;
+    }
+#endif
+    while (position < len && data[position] < 0x80) {
+        position++;
+    }
+    return position;
+}
+
+bool utf8_validate(const uint8_t *data, uint32_t len) {
+    uint32_t position = 0;
+    while (true) {
+        position = skip_ascii(data, position, len);
+        if (position >= len) {
+            return true;
+        }
+        uint8_t lead = data[position];
+        uint32_t count;
+        uint8_t min = 0x80;
+        uint8_t max = 0xbf;
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            count = 1;
+        } else if (lead >= 0xe0 && lead <= 0xef) {
+            count = 2;
+            if (lead == 0xe0) {
+                min = 0xa0;
+            } else if (lead == 0xed) {
+                max = 0x9f;
+            }
+        } else if (lead >= 0xf0 && lead <= 0xf4) {
+            count = 3;
+            if (lead == 0xf0) {
+                min = 0x90;
+            } else if (lead == 0xf4) {
+                max = 0x8f;
+            }
+        } else {
+            return false;
+        }
+        if (position + count >= len) {
+            return false;
+        }
+        uint8_t second = data[position + 1];
+        if (second < min || second > max) {
+            return false;
+        }
+        for (uint32_t a = 2; a <= count; a++) {
+            if ((data[position + a] & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        position += count + 1;
+    }
+}
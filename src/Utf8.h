@@ -0,0 +1,19 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_UTF8_H
+#define TKS_PROTO_BUFFER_UTF8_H
+
+#include <cstdint>
+
+/*
+ * Returns true when data[0, len) is well-formed UTF-8 (no overlong forms, surrogates or code
+ * points above U+10FFFF). ASCII runs are skipped 16 or 32 bytes at a time with SSE2/AVX2/NEON;
+ * multi-byte sequences are checked by the scalar decoder.
+ */
+bool utf8_validate(const uint8_t *data, uint32_t len);
+
+#endif //TKS_PROTO_BUFFER_UTF8_H
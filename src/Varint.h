@@ -0,0 +1,97 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+#ifndef TKS_PROTO_BUFFER_VARINT_H
+#define TKS_PROTO_BUFFER_VARINT_H
+
+#include "ByteSwap.h"
+#include <cstdint>
+#include <memory.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+static const uint32_t varint_max_size = 10;
+
+static inline uint32_t varint_size(uint64_t x) {
+    // 1 + floor(bit_length / 7), computed without a loop; x | 1 keeps clz defined for 0.
+    auto bits = (uint32_t) (64 - __builtin_clzll(x | 1));
+    return (bits * 9 + 64) / 64;
+}
+
+static inline uint64_t zigzag_encode(int64_t x) {
+    return ((uint64_t) x << 1) ^ (uint64_t) (x >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t x) {
+    return (int64_t) (x >> 1) ^ -(int64_t) (x & 1);
+}
+
+/*
+ * Writes x as LEB128 at out, which must have varint_size(x) bytes. Returns that size.
+ */
+static inline uint32_t varint_encode(uint8_t *out, uint64_t x) {
+    uint32_t length = 0;
+    while (x >= 0x80) {
+        out[length++] = (uint8_t) (x | 0x80);
+        x >>= 7;
+    }
+    out[length++] = (uint8_t) x;
+    return length;
+}
+
+/*
+ * Decodes the varint at data, reading at most `available` bytes. Returns the number of bytes
+ * consumed, or 0 when the varint is truncated or longer than 10 bytes.
+ */
+static inline uint32_t varint_decode_slow(const uint8_t *data, uint32_t available, uint64_t *value) {
+    uint64_t result = 0;
+    uint32_t limit = available < varint_max_size ? available : varint_max_size;
+    for (uint32_t a = 0; a < limit; a++) {
+        result |= (uint64_t) (data[a] & 0x7f) << (7 * a);
+        if ((data[a] & 0x80) == 0) {
+            *value = result;
+            return a + 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Same as varint_decode_slow, for callers that can read 8 bytes at data. Varints of up to 8
+ * bytes (values below 2^56) are decoded without a per-byte loop: one load, the length from
+ * the first clear continuation bit, and the 7-bit groups gathered with pext (BMI2) or three
+ * shift-and-mask steps. Longer varints fall back to the loop.
+ */
+static inline uint32_t varint_decode_fast(const uint8_t *data, uint32_t available, uint64_t *value) {
+    if (data[0] < 0x80) {
+        *value = data[0];
+        return 1;
+    }
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+#if TKS_HOST_BIG_ENDIAN
+    word = __builtin_bswap64(word);
+#endif
+    uint64_t stops = ~word & 0x8080808080808080ull;
+    if (stops == 0) {
+        return varint_decode_slow(data, available, value);
+    }
+    // Every bit up to and including the first stop bit: exactly the varint's bytes.
+    word &= stops ^ (stops - 1);
+#if defined(__BMI2__)
+    *value = _pext_u64(word, 0x7f7f7f7f7f7f7f7full);
+#else
+    word = (word & 0x007f007f007f007full) | ((word & 0x7f007f007f007f00ull) >> 1);
+    word = (word & 0x00003fff00003fffull) | ((word & 0x3fff00003fff0000ull) >> 2);
+    word = (word & 0x000000000fffffffull) | ((word & 0x0fffffff00000000ull) >> 4);
+    *value = word;
+#endif
+    return (uint32_t) (__builtin_ctzll(stops) >> 3) + 1;
+}
+
+#endif //TKS_PROTO_BUFFER_VARINT_H
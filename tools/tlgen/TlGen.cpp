@@ -0,0 +1,819 @@
+/*
+ * Created by Steve Tchatchouang
+ *
+ * Copyright (c) 2022 All rights reserved
+ */
+
+/*
+ * buffer_tlgen: generates a header of C++ structs with ProtoBuffer serializers from a TL
+ * schema.
+ *
+ *   buffer_tlgen schema.tl output.h [namespace]
+ *
+ * Every constructor `name#id fields = Type;` becomes a struct `name` (dots replaced by '_')
+ * with:
+ *   - constructor, fixed_size and has_fixed_size as compile-time constants. fixed_size
+ *     covers every field whose encoding has a fixed length.
+ *   - size(), the exact bare size, which only adds up the variable-length fields.
+ *   - serialize()/serialize_boxed() and deserialize(), straight write_* / read_* calls.
+ * A type with several constructors becomes a std::variant of them, with size_Type(),
+ * write_Type() and read_Type() dispatching on the alternative / constructor id.
+ *
+ * Supported field types: int, long, double, string, bytes, Bool, #, flags.N?type (optional
+ * fields, true for flag-only ones), Vector<t>, vector<t>, and other schema types, boxed or
+ * bare. Lines without an explicit #id, generic constructors and the constructors of the built-in
+ * Bool and True types are skipped. Recursive types are rejected.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct TypeRef {
+    enum Kind {
+        Int, Long, Double, String, Bytes, Bool, True, Flags, Vector, Struct, Variant
+    };
+    Kind kind{Int};
+    bool boxed{true};
+    std::shared_ptr<TypeRef> element;
+    std::string name;
+};
+
+struct Field {
+    std::string name;
+    std::string raw_type;
+    TypeRef type;
+    std::string flag_field;
+    int32_t flag_bit{-1};
+};
+
+struct Constructor {
+    std::string name;
+    std::string cpp_name;
+    uint32_t id{0};
+    std::vector<Field> fields;
+    std::string result;
+    bool function{false};
+    int32_t fixed{-2};
+};
+
+static std::vector<Constructor> constructors;
+static std::map<std::string, size_t> constructor_by_name;
+static std::map<std::string, std::vector<size_t>> types;
+static std::vector<std::string> type_order;
+static std::string name_space = "tl";
+static bool failed = false;
+
+static void fail(const std::string &message) {
+    fprintf(stderr, "buffer_tlgen: %s\n", message.c_str());
+    failed = true;
+}
+
+static std::string cpp_identifier(const std::string &name) {
+    static const std::set<std::string> keywords = {
+            "auto", "bool", "break", "case", "catch", "char", "class", "const", "continue", "default",
+            "delete", "do", "double", "else", "enum", "explicit", "export", "extern", "false", "float",
+            "for", "friend", "goto", "if", "inline", "int", "long", "namespace", "new", "operator",
+            "private", "protected", "public", "register", "return", "short", "signed", "sizeof",
+            "static", "struct", "switch", "template", "this", "throw", "true", "try", "typedef",
+            "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "while",
+            "constructor", "fixed_size", "has_fixed_size", "size", "serialize", "serialize_boxed",
+            "deserialize", "size_boxed", "buffer", "error"};
+    std::string result = name;
+    std::replace(result.begin(), result.end(), '.', '_');
+    if (keywords.count(result) != 0) {
+        result += "_";
+    }
+    return result;
+}
+
+static std::string trim(const std::string &s) {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+}
+
+static std::string hex(uint32_t value) {
+    char text[16];
+    snprintf(text, sizeof(text), "0x%08x", value);
+    return text;
+}
+
+static void parse_declaration(const std::string &line, bool function) {
+    size_t equals = line.rfind('=');
+    if (equals == std::string::npos) {
+        fail("missing '=' in: " + line);
+        return;
+    }
+    std::string result = trim(line.substr(equals + 1));
+    std::istringstream head(line.substr(0, equals));
+    std::string combinator;
+    head >> combinator;
+    size_t hash = combinator.find('#');
+    if (hash == std::string::npos || line.find('{') != std::string::npos ||
+        (!function && (result == "Bool" || result == "True"))) {
+        return;
+    }
+    Constructor constructor;
+    constructor.name = combinator.substr(0, hash);
+    constructor.cpp_name = cpp_identifier(constructor.name);
+    constructor.id = (uint32_t) strtoul(combinator.substr(hash + 1).c_str(), nullptr, 16);
+    constructor.result = result;
+    constructor.function = function;
+    std::string parameter;
+    while (head >> parameter) {
+        size_t colon = parameter.find(':');
+        if (colon == std::string::npos) {
+            fail("bad parameter '" + parameter + "' in " + constructor.name);
+            return;
+        }
+        Field field;
+        field.name = cpp_identifier(parameter.substr(0, colon));
+        std::string type = parameter.substr(colon + 1);
+        size_t question = type.find('?');
+        if (question != std::string::npos) {
+            std::string condition = type.substr(0, question);
+            size_t dot = condition.find('.');
+            if (dot == std::string::npos) {
+                fail("bad condition '" + condition + "' in " + constructor.name);
+                return;
+            }
+            field.flag_field = cpp_identifier(condition.substr(0, dot));
+            field.flag_bit = (int32_t) strtol(condition.substr(dot + 1).c_str(), nullptr, 10);
+            type = type.substr(question + 1);
+        }
+        field.raw_type = type;
+        constructor.fields.push_back(field);
+    }
+    if (constructor_by_name.count(constructor.name) != 0) {
+        fail("duplicate constructor " + constructor.name);
+        return;
+    }
+    constructor_by_name[constructor.name] = constructors.size();
+    if (!function) {
+        if (types.count(result) == 0) {
+            type_order.push_back(result);
+        }
+        types[result].push_back(constructors.size());
+    }
+    constructors.push_back(constructor);
+}
+
+static bool resolve(const std::string &raw, TypeRef *type, const std::string &context) {
+    static const std::map<std::string, TypeRef::Kind> builtins = {
+            {"int",    TypeRef::Int},
+            {"long",   TypeRef::Long},
+            {"double", TypeRef::Double},
+            {"string", TypeRef::String},
+            {"bytes",  TypeRef::Bytes},
+            {"Bool",   TypeRef::Bool},
+            {"true",   TypeRef::True},
+            {"#",      TypeRef::Flags}};
+    auto builtin = builtins.find(raw);
+    if (builtin != builtins.end()) {
+        type->kind = builtin->second;
+        return true;
+    }
+    if ((raw.rfind("Vector<", 0) == 0 || raw.rfind("vector<", 0) == 0) && raw.back() == '>') {
+        type->kind = TypeRef::Vector;
+        type->boxed = raw[0] == 'V';
+        type->element = std::make_shared<TypeRef>();
+        return resolve(raw.substr(7, raw.size() - 8), type->element.get(), context);
+    }
+    std::string name = raw;
+    bool bare = false;
+    if (!name.empty() && name[0] == '%') {
+        name = name.substr(1);
+        bare = true;
+    }
+    auto group = types.find(name);
+    if (group != types.end()) {
+        if (group->second.size() == 1) {
+            type->kind = TypeRef::Struct;
+            type->boxed = !bare;
+            type->name = constructors[group->second[0]].name;
+        } else if (!bare) {
+            type->kind = TypeRef::Variant;
+            type->name = name;
+        } else {
+            fail("bare reference to polymorphic type " + name + " in " + context);
+            return false;
+        }
+        return true;
+    }
+    auto constructor = constructor_by_name.find(name);
+    if (constructor != constructor_by_name.end() && !constructors[constructor->second].function) {
+        type->kind = TypeRef::Struct;
+        type->boxed = false;
+        type->name = name;
+        return true;
+    }
+    fail("unknown or unsupported type '" + raw + "' in " + context);
+    return false;
+}
+
+/*
+ * Field types are fully qualified: TL happily names a field after a type (message:Message), and
+ * an unqualified type name would change meaning inside the struct.
+ */
+static std::string qualified(const std::string &name) {
+    return "::" + name_space + "::" + name;
+}
+
+static std::string cpp_type(const TypeRef &type) {
+    switch (type.kind) {
+        case TypeRef::Int:
+            return "int32_t";
+        case TypeRef::Long:
+            return "int64_t";
+        case TypeRef::Double:
+            return "double";
+        case TypeRef::String:
+            return "std::string";
+        case TypeRef::Bytes:
+            return "std::vector<uint8_t>";
+        case TypeRef::Bool:
+        case TypeRef::True:
+            return "bool";
+        case TypeRef::Flags:
+            return "uint32_t";
+        case TypeRef::Vector:
+            return "std::vector<" + cpp_type(*type.element) + ">";
+        case TypeRef::Struct:
+            return qualified(constructors[constructor_by_name[type.name]].cpp_name);
+        case TypeRef::Variant:
+            return qualified(cpp_identifier(type.name));
+    }
+    return "";
+}
+
+static int32_t constructor_fixed_size(Constructor &constructor);
+
+/*
+ * Encoded size of a value of this type when it does not depend on the value, -1 otherwise.
+ */
+static int32_t fixed_size(const TypeRef &type) {
+    switch (type.kind) {
+        case TypeRef::Int:
+        case TypeRef::Bool:
+        case TypeRef::Flags:
+            return 4;
+        case TypeRef::Long:
+        case TypeRef::Double:
+            return 8;
+        case TypeRef::True:
+            return 0;
+        case TypeRef::Struct: {
+            int32_t size = constructor_fixed_size(constructors[constructor_by_name[type.name]]);
+            return size < 0 ? -1 : size + (type.boxed ? 4 : 0);
+        }
+        default:
+            return -1;
+    }
+}
+
+static int32_t constructor_fixed_size(Constructor &constructor) {
+    if (constructor.fixed != -2) {
+        return constructor.fixed;
+    }
+    int32_t total = 0;
+    for (const Field &field : constructor.fields) {
+        int32_t size = fixed_size(field.type);
+        if (size < 0 || (field.flag_bit >= 0 && field.type.kind != TypeRef::True)) {
+            constructor.fixed = -1;
+            return -1;
+        }
+        total += size;
+    }
+    constructor.fixed = total;
+    return total;
+}
+
+/*
+ * Bytes of the fields whose size is fixed and unconditional.
+ */
+static uint32_t fixed_part(Constructor &constructor) {
+    uint32_t total = 0;
+    for (const Field &field : constructor.fields) {
+        int32_t size = fixed_size(field.type);
+        if (size > 0 && field.flag_bit < 0) {
+            total += (uint32_t) size;
+        }
+    }
+    return total;
+}
+
+/*
+ * Fewest bytes a value of this type takes when encoded. Vector reads check the element count
+ * against it, so a forged count can't make them allocate far more than the buffer holds.
+ */
+static uint32_t min_size(const TypeRef &type) {
+    int32_t fixed = fixed_size(type);
+    if (fixed >= 0) {
+        return (uint32_t) fixed;
+    }
+    switch (type.kind) {
+        case TypeRef::String:
+        case TypeRef::Bytes:
+        case TypeRef::Variant:
+            return 4;
+        case TypeRef::Vector:
+            return type.boxed ? 8 : 4;
+        case TypeRef::Struct: {
+            uint32_t total = type.boxed ? 4 : 0;
+            for (const Field &field : constructors[constructor_by_name[type.name]].fields) {
+                if (field.flag_bit < 0) {
+                    total += min_size(field.type);
+                }
+            }
+            return total;
+        }
+        default:
+            return 0;
+    }
+}
+
+static std::string indent(int level) {
+    return std::string((size_t) level * 4, ' ');
+}
+
+static void emit_size(std::ostream &out, const TypeRef &type, const std::string &value, int level) {
+    int32_t fixed = fixed_size(type);
+    if (fixed >= 0) {
+        if (fixed > 0) {
+            out << indent(level) << "size += " << fixed << ";\n";
+        }
+        return;
+    }
+    switch (type.kind) {
+        case TypeRef::String:
+        case TypeRef::Bytes:
+            out << indent(level) << "size += ProtoBuffer::byte_array_size((uint32_t) " << value << ".size());\n";
+            break;
+        case TypeRef::Vector: {
+            out << indent(level) << "size += " << (type.boxed ? 8 : 4) << ";\n";
+            int32_t element = fixed_size(*type.element);
+            if (element >= 0) {
+                out << indent(level) << "size += (uint32_t) " << value << ".size() * " << element << ";\n";
+            } else {
+                std::string item = "item" + std::to_string(level);
+                out << indent(level) << "for (const auto &" << item << " : " << value << ") {\n";
+                emit_size(out, *type.element, item, level + 1);
+                out << indent(level) << "}\n";
+            }
+            break;
+        }
+        case TypeRef::Struct:
+            out << indent(level) << "size += " << (type.boxed ? "4 + " : "") << value << ".size();\n";
+            break;
+        case TypeRef::Variant:
+            out << indent(level) << "size += size_" << cpp_identifier(type.name) << "(" << value << ");\n";
+            break;
+        default:
+            break;
+    }
+}
+
+static void emit_write(std::ostream &out, const TypeRef &type, const std::string &value, int level) {
+    std::string line = indent(level);
+    switch (type.kind) {
+        case TypeRef::Int:
+            out << line << "buffer->write_int((int32_t) " << value << ", error);\n";
+            break;
+        case TypeRef::Flags:
+            out << line << "buffer->write_int((uint32_t) " << value << ", error);\n";
+            break;
+        case TypeRef::Long:
+            out << line << "buffer->write_long(" << value << ", error);\n";
+            break;
+        case TypeRef::Double:
+            out << line << "buffer->write_double(" << value << ", error);\n";
+            break;
+        case TypeRef::Bool:
+            out << line << "buffer->write_int(" << value << " ? tl_bool_true : tl_bool_false, error);\n";
+            break;
+        case TypeRef::True:
+            break;
+        case TypeRef::String:
+            out << line << "buffer->write_string(" << value << ", error);\n";
+            break;
+        case TypeRef::Bytes:
+            out << line << "buffer->write_byte_array((uint8_t *) " << value << ".data(), (uint32_t) " << value
+                << ".size(), error);\n";
+            break;
+        case TypeRef::Vector: {
+            if (type.boxed) {
+                out << line << "buffer->write_int(tl_vector, error);\n";
+            }
+            out << line << "buffer->write_int((uint32_t) " << value << ".size(), error);\n";
+            TypeRef::Kind element = type.element->kind;
+            if (element == TypeRef::Int || element == TypeRef::Long || element == TypeRef::Double) {
+                const char *method = element == TypeRef::Int ? "write_int_array" :
+                                     element == TypeRef::Long ? "write_long_array" : "write_double_array";
+                out << line << "buffer->" << method << "(" << value << ".data(), (uint32_t) " << value
+                    << ".size(), error);\n";
+            } else {
+                std::string item = "item" + std::to_string(level);
+                out << line << "for (const auto &" << item << " : " << value << ") {\n";
+                emit_write(out, *type.element, item, level + 1);
+                out << line << "}\n";
+            }
+            break;
+        }
+        case TypeRef::Struct:
+            out << line << value << (type.boxed ? ".serialize_boxed" : ".serialize") << "(buffer, error);\n";
+            break;
+        case TypeRef::Variant:
+            out << line << "write_" << cpp_identifier(type.name) << "(" << value << ", buffer, error);\n";
+            break;
+    }
+}
+
+static void emit_read(std::ostream &out, const TypeRef &type, const std::string &target, int level) {
+    std::string line = indent(level);
+    switch (type.kind) {
+        case TypeRef::Int:
+            out << line << target << " = buffer->read_int(error);\n";
+            break;
+        case TypeRef::Flags:
+            out << line << target << " = buffer->read_u_int(error);\n";
+            break;
+        case TypeRef::Long:
+            out << line << target << " = buffer->read_long(error);\n";
+            break;
+        case TypeRef::Double:
+            out << line << target << " = buffer->read_double(error);\n";
+            break;
+        case TypeRef::Bool:
+            out << line << target << " = tl_read_bool(buffer, error);\n";
+            break;
+        case TypeRef::True:
+            break;
+        case TypeRef::String:
+            out << line << target << " = buffer->read_string(error);\n";
+            break;
+        case TypeRef::Bytes:
+            out << line << "tl_read_bytes(buffer, &" << target << ", error);\n";
+            break;
+        case TypeRef::Vector: {
+            // Each vector gets its own block so sibling vectors can reuse the local names.
+            out << line << "{\n";
+            level++;
+            line = indent(level);
+            std::string count = "count" + std::to_string(level);
+            if (type.boxed) {
+                out << line << "if (buffer->read_u_int(error) != tl_vector) {\n"
+                    << line << "    *error = true;\n" << line << "    return;\n" << line << "}\n";
+            }
+            out << line << "uint32_t " << count << " = buffer->read_u_int(error);\n";
+            uint32_t element_size = min_size(*type.element);
+            if (element_size > 1) {
+                out << line << "if (*error || (uint64_t) " << count << " * " << element_size
+                    << " > buffer->remaining()) {\n";
+            } else {
+                out << line << "if (*error || " << count << " > buffer->remaining()) {\n";
+            }
+            out << line << "    *error = true;\n" << line << "    return;\n" << line << "}\n";
+            TypeRef::Kind element = type.element->kind;
+            if (element == TypeRef::Int || element == TypeRef::Long || element == TypeRef::Double) {
+                const char *method = element == TypeRef::Int ? "read_int_array" :
+                                     element == TypeRef::Long ? "read_long_array" : "read_double_array";
+                out << line << target << ".resize(" << count << ");\n";
+                out << line << "buffer->" << method << "(" << target << ".data(), " << count << ", error);\n";
+            } else {
+                std::string index = "a" + std::to_string(level);
+                out << line << target << ".clear();\n";
+                out << line << target << ".reserve(" << count << ");\n";
+                out << line << "for (uint32_t " << index << " = 0; " << index << " < " << count << " && !*error; "
+                    << index << "++) {\n";
+                if (type.element->kind == TypeRef::Bool) {
+                    out << line << "    " << target << ".push_back(tl_read_bool(buffer, error));\n";
+                } else {
+                    out << line << "    " << target << ".emplace_back();\n";
+                    emit_read(out, *type.element, target + ".back()", level + 1);
+                }
+                out << line << "}\n";
+            }
+            out << indent(level - 1) << "}\n";
+            break;
+        }
+        case TypeRef::Struct: {
+            std::string name = qualified(constructors[constructor_by_name[type.name]].cpp_name);
+            if (type.boxed) {
+                out << line << "if (buffer->read_u_int(error) != " << name << "::constructor) {\n"
+                    << line << "    *error = true;\n" << line << "    return;\n" << line << "}\n";
+            }
+            out << line << target << ".deserialize(buffer, error);\n";
+            break;
+        }
+        case TypeRef::Variant:
+            out << line << target << " = read_" << cpp_identifier(type.name) << "(buffer, error);\n";
+            break;
+    }
+}
+
+static void emit_struct(std::ostream &out, Constructor &constructor) {
+    int32_t fixed = constructor_fixed_size(constructor);
+    out << "struct " << constructor.cpp_name << " {\n";
+    out << "    static constexpr uint32_t constructor = " << hex(constructor.id) << ";\n";
+    out << "    static constexpr uint32_t fixed_size = " << fixed_part(constructor) << ";\n";
+    out << "    static constexpr bool has_fixed_size = " << (fixed >= 0 ? "true" : "false") << ";\n\n";
+    for (const Field &field : constructor.fields) {
+        std::string type = cpp_type(field.type);
+        if (field.flag_bit >= 0 && field.type.kind != TypeRef::True) {
+            out << "    std::optional<" << type << "> " << field.name << ";\n";
+        } else if (field.type.kind == TypeRef::Struct || field.type.kind == TypeRef::Variant ||
+                   field.type.kind == TypeRef::Vector || field.type.kind == TypeRef::String ||
+                   field.type.kind == TypeRef::Bytes) {
+            out << "    " << type << " " << field.name << ";\n";
+        } else {
+            out << "    " << type << " " << field.name << "{};\n";
+        }
+    }
+    if (!constructor.fields.empty()) {
+        out << "\n";
+    }
+
+    out << "    [[nodiscard]] uint32_t size() const {\n";
+    if (fixed >= 0) {
+        out << "        return fixed_size;\n";
+    } else {
+        out << "        uint32_t size = fixed_size;\n";
+        for (const Field &field : constructor.fields) {
+            if (field.flag_bit >= 0) {
+                if (field.type.kind == TypeRef::True) {
+                    continue;
+                }
+                out << "        if (" << field.name << ") {\n";
+                emit_size(out, field.type, "(*" + field.name + ")", 3);
+                out << "        }\n";
+            } else if (fixed_size(field.type) < 0) {
+                emit_size(out, field.type, field.name, 2);
+            }
+        }
+        out << "        return size;\n";
+    }
+    out << "    }\n\n";
+    out << "    [[nodiscard]] uint32_t size_boxed() const {\n"
+        << "        return 4 + size();\n"
+        << "    }\n\n";
+
+    if (constructor.fields.empty()) {
+        out << "    void serialize(ProtoBuffer * /*buffer*/, bool * /*error*/ = nullptr) const {\n";
+    } else {
+        out << "    void serialize(ProtoBuffer *buffer, bool *error = nullptr) const {\n";
+    }
+    for (const Field &field : constructor.fields) {
+        if (field.type.kind == TypeRef::Flags) {
+            std::string value = field.name + "_value";
+            out << "        uint32_t " << value << " = " << field.name << ";\n";
+            for (const Field &conditional : constructor.fields) {
+                if (conditional.flag_field != field.name) {
+                    continue;
+                }
+                std::string bit = "(1u << " + std::to_string(conditional.flag_bit) + ")";
+                out << "        " << value << " = " << conditional.name << " ? (" << value << " | " << bit
+                    << ") : (" << value << " & ~" << bit << ");\n";
+            }
+            emit_write(out, field.type, value, 2);
+        } else if (field.flag_bit >= 0) {
+            if (field.type.kind == TypeRef::True) {
+                continue;
+            }
+            out << "        if (" << field.name << ") {\n";
+            emit_write(out, field.type, "(*" + field.name + ")", 3);
+            out << "        }\n";
+        } else {
+            emit_write(out, field.type, field.name, 2);
+        }
+    }
+    out << "    }\n\n";
+    out << "    void serialize_boxed(ProtoBuffer *buffer, bool *error = nullptr) const {\n"
+        << "        buffer->write_int(constructor, error);\n"
+        << "        serialize(buffer, error);\n"
+        << "    }\n\n";
+
+    out << "    /*\n     * Reads the fields; the constructor id, when boxed, was already consumed.\n     */\n";
+    if (constructor.fields.empty()) {
+        out << "    void deserialize(ProtoBuffer * /*buffer*/, bool * /*error*/ = nullptr) {\n";
+    } else {
+        out << "    void deserialize(ProtoBuffer *buffer, bool *error = nullptr) {\n";
+        out << "        bool failed = false;\n"
+            << "        if (error == nullptr) {\n"
+            << "            error = &failed;\n"
+            << "        }\n";
+    }
+    for (const Field &field : constructor.fields) {
+        if (field.flag_bit >= 0) {
+            std::string condition = "(" + field.flag_field + " & (1u << " + std::to_string(field.flag_bit) + ")) != 0";
+            if (field.type.kind == TypeRef::True) {
+                out << "        " << field.name << " = " << condition << ";\n";
+                continue;
+            }
+            out << "        if (" << condition << ") {\n";
+            out << "            " << field.name << ".emplace();\n";
+            emit_read(out, field.type, "(*" + field.name + ")", 3);
+            out << "        } else {\n";
+            out << "            " << field.name << ".reset();\n";
+            out << "        }\n";
+        } else {
+            emit_read(out, field.type, field.name, 2);
+        }
+    }
+    out << "    }\n";
+    out << "};\n\n";
+}
+
+static void emit_variant(std::ostream &out, const std::string &type) {
+    std::string name = cpp_identifier(type);
+    const std::vector<size_t> &members = types[type];
+    out << "using " << name << " = std::variant<";
+    for (size_t a = 0; a < members.size(); a++) {
+        out << (a == 0 ? "" : ", ") << constructors[members[a]].cpp_name;
+    }
+    out << ">;\n\n";
+    out << "inline uint32_t size_" << name << "(const " << name << " &value) {\n"
+        << "    return std::visit([](const auto &item) { return item.size_boxed(); }, value);\n"
+        << "}\n\n";
+    out << "inline void write_" << name << "(const " << name << " &value, ProtoBuffer *buffer, bool *error) {\n"
+        << "    std::visit([buffer, error](const auto &item) { item.serialize_boxed(buffer, error); }, value);\n"
+        << "}\n\n";
+    out << "inline " << name << " read_" << name << "(ProtoBuffer *buffer, bool *error) {\n"
+        << "    " << name << " value;\n"
+        << "    switch (buffer->read_u_int(error)) {\n";
+    for (size_t member : members) {
+        const std::string &cpp_name = constructors[member].cpp_name;
+        out << "        case " << cpp_name << "::constructor:\n"
+            << "            value.emplace<" << cpp_name << ">().deserialize(buffer, error);\n"
+            << "            break;\n";
+    }
+    out << "        default:\n"
+        << "            if (error != nullptr) {\n"
+        << "                *error = true;\n"
+        << "            }\n"
+        << "            break;\n"
+        << "    }\n"
+        << "    return value;\n"
+        << "}\n\n";
+}
+
+static void collect_dependencies(const TypeRef &type, std::set<std::string> *dependencies) {
+    if (type.kind == TypeRef::Vector) {
+        collect_dependencies(*type.element, dependencies);
+    } else if (type.kind == TypeRef::Struct) {
+        dependencies->insert(constructors[constructor_by_name[type.name]].result);
+    } else if (type.kind == TypeRef::Variant) {
+        dependencies->insert(type.name);
+    }
+}
+
+static void visit(const std::string &type, std::map<std::string, int> *state, std::vector<std::string> *order) {
+    int &mark = (*state)[type];
+    if (mark == 2) {
+        return;
+    }
+    if (mark == 1) {
+        fail("recursive type " + type + " is not supported");
+        return;
+    }
+    mark = 1;
+    std::set<std::string> dependencies;
+    for (size_t member : types[type]) {
+        for (const Field &field : constructors[member].fields) {
+            collect_dependencies(field.type, &dependencies);
+        }
+    }
+    for (const std::string &dependency : dependencies) {
+        visit(dependency, state, order);
+    }
+    (*state)[type] = 2;
+    order->push_back(type);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: buffer_tlgen schema.tl output.h [namespace]\n");
+        return 2;
+    }
+    std::ifstream schema(argv[1]);
+    if (!schema) {
+        fprintf(stderr, "buffer_tlgen: can't read %s\n", argv[1]);
+        return 1;
+    }
+    if (argc > 3) {
+        name_space = argv[3];
+    }
+
+    bool functions = false;
+    std::string pending;
+    std::string line;
+    while (std::getline(schema, line)) {
+        size_t comment = line.find("//");
+        if (comment != std::string::npos) {
+            line = line.substr(0, comment);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        if (line == "---functions---") {
+            functions = true;
+            continue;
+        }
+        if (line == "---types---") {
+            functions = false;
+            continue;
+        }
+        pending += (pending.empty() ? "" : " ") + line;
+        size_t end;
+        while ((end = pending.find(';')) != std::string::npos) {
+            parse_declaration(trim(pending.substr(0, end)), functions);
+            pending = trim(pending.substr(end + 1));
+        }
+    }
+    for (Constructor &constructor : constructors) {
+        std::set<std::string> flag_fields;
+        for (Field &field : constructor.fields) {
+            resolve(field.raw_type, &field.type, constructor.name);
+            if (field.flag_bit >= 0 && flag_fields.count(field.flag_field) == 0) {
+                fail("condition on " + field.flag_field + ", not an earlier # field, in " + constructor.name);
+            }
+            if (field.type.kind == TypeRef::Flags) {
+                flag_fields.insert(field.name);
+            }
+        }
+    }
+    if (failed) {
+        return 1;
+    }
+
+    std::map<std::string, int> state;
+    std::vector<std::string> order;
+    for (const std::string &type : type_order) {
+        visit(type, &state, &order);
+    }
+    if (failed) {
+        return 1;
+    }
+
+    std::ostringstream out;
+    out << "/*\n * Generated by buffer_tlgen from " << argv[1] << ". Do not edit.\n */\n\n"
+        << "#pragma once\n\n"
+        << "#include \"buffer/ProtoBuffer.h\"\n"
+        << "#include <cstdint>\n"
+        << "#include <optional>\n"
+        << "#include <string>\n"
+        << "#include <string_view>\n"
+        << "#include <variant>\n"
+        << "#include <vector>\n\n"
+        << "namespace " << name_space << " {\n\n"
+        << "static const uint32_t tl_vector = 0x1cb5c415;\n"
+        << "static const uint32_t tl_bool_true = 0x997275b5;\n"
+        << "static const uint32_t tl_bool_false = 0xbc799737;\n\n"
+        << "inline bool tl_read_bool(ProtoBuffer *buffer, bool *error) {\n"
+        << "    uint32_t value = buffer->read_u_int(error);\n"
+        << "    if (value != tl_bool_true && value != tl_bool_false && error != nullptr) {\n"
+        << "        *error = true;\n"
+        << "    }\n"
+        << "    return value == tl_bool_true;\n"
+        << "}\n\n"
+        << "inline void tl_read_bytes(ProtoBuffer *buffer, std::vector<uint8_t> *target, bool *error) {\n"
+        << "    bool validate = buffer->validate_utf8();\n"
+        << "    buffer->validate_utf8(false);\n"
+        << "    std::string_view bytes = buffer->read_string_view(error);\n"
+        << "    buffer->validate_utf8(validate);\n"
+        << "    target->assign((const uint8_t *) bytes.data(), (const uint8_t *) bytes.data() + bytes.size());\n"
+        << "}\n\n";
+    for (const std::string &type : order) {
+        for (size_t member : types[type]) {
+            emit_struct(out, constructors[member]);
+        }
+        if (types[type].size() > 1) {
+            emit_variant(out, type);
+        }
+    }
+    for (Constructor &constructor : constructors) {
+        if (constructor.function) {
+            emit_struct(out, constructor);
+        }
+    }
+    out << "} // namespace " << name_space << "\n";
+
+    std::ofstream output(argv[2]);
+    output << out.str();
+    if (!output) {
+        fprintf(stderr, "buffer_tlgen: can't write %s\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}